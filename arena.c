@@ -0,0 +1,191 @@
+#include "shell.h"
+
+/*
+ * Bump allocator for everything that lives for one input line: tokens,
+ * token lists, pipelines and argument vectors.  Chunks are kept across
+ * resets, so once the arena has grown to fit a typical line, handling
+ * another line does not call malloc at all.
+ */
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define CHUNK_HEADER ARENA_ROUND(sizeof(struct arena_chunk))
+
+/**
+ * arena_init - prepare an empty arena
+ * @a: arena
+ * @chunk_size: size of each chunk's data area
+ */
+
+void arena_init(Arena *a, size_t chunk_size)
+{
+	a->head = NULL;
+	a->cur = NULL;
+	a->chunk_size = chunk_size;
+	_memset((char *)&a->stats, 0, sizeof(a->stats));
+}
+
+/**
+ * arena_new_chunk - allocate a chunk and link it after the current one
+ * @a: arena
+ * @min: number of bytes the chunk must hold
+ * Return: the chunk, or NULL on allocation failure
+ */
+
+static struct arena_chunk *arena_new_chunk(Arena *a, size_t min)
+{
+	size_t size = min > a->chunk_size ? min : a->chunk_size;
+	struct arena_chunk *c = malloc(CHUNK_HEADER + size);
+
+	if (c == NULL)
+		return (NULL);
+	c->size = size;
+	c->used = 0;
+	if (a->cur == NULL)
+	{
+		c->next = a->head;
+		a->head = c;
+	}
+	else
+	{
+		c->next = a->cur->next;
+		a->cur->next = c;
+	}
+	a->stats.chunk_mallocs++;
+	a->stats.line_mallocs++;
+	a->stats.reserved += size;
+	return (c);
+}
+
+/**
+ * arena_alloc - allocate memory from an arena
+ * @a: arena
+ * @n: number of bytes
+ *
+ * The memory stays valid until the next arena_reset().
+ * Return: pointer aligned to ARENA_ALIGN, or NULL on allocation failure
+ */
+
+void *arena_alloc(Arena *a, size_t n)
+{
+	struct arena_chunk *c = a->cur;
+	void *p;
+
+	n = ARENA_ROUND(n ? n : 1);
+	while (c == NULL || c->size - c->used < n)
+	{
+		if (c != NULL && c->next != NULL && c->next->size >= n)
+		{
+			c = c->next;
+			c->used = 0;
+		}
+		else if (c == NULL && a->head != NULL && a->head->size >= n)
+		{
+			c = a->head;
+			c->used = 0;
+		}
+		else
+		{
+			c = arena_new_chunk(a, n);
+			if (c == NULL)
+				return (NULL);
+		}
+		a->cur = c;
+	}
+
+	p = (char *)c + CHUNK_HEADER + c->used;
+	c->used += n;
+	a->stats.allocs++;
+	a->stats.bytes += n;
+	return (p);
+}
+
+/**
+ * arena_strdup - copy a string into an arena
+ * @a: arena
+ * @s: string
+ * Return: the copy, or NULL on allocation failure
+ */
+
+char *arena_strdup(Arena *a, const char *s)
+{
+	return (arena_strndup(a, s, strlen(s)));
+}
+
+/**
+ * arena_strndup - copy the first @n bytes of a string into an arena
+ * @a: arena
+ * @s: string
+ * @n: number of bytes to copy
+ * Return: the NUL-terminated copy, or NULL on allocation failure
+ */
+
+char *arena_strndup(Arena *a, const char *s, size_t n)
+{
+	char *p = arena_alloc(a, n + 1);
+
+	if (p == NULL)
+		return (NULL);
+	memcpy(p, s, n);
+	p[n] = '\0';
+	return (p);
+}
+
+/**
+ * arena_reset - release everything allocated from an arena
+ * @a: arena
+ *
+ * Constant time: chunks are kept, and each one is rewound only when the
+ * allocator reaches it again.
+ */
+
+void arena_reset(Arena *a)
+{
+	if (a->stats.high_water < a->stats.bytes)
+		a->stats.high_water = a->stats.bytes;
+	a->cur = NULL;
+	a->stats.bytes = 0;
+	a->stats.line_mallocs = 0;
+	a->stats.resets++;
+}
+
+/**
+ * arena_free - return every chunk of an arena to malloc
+ * @a: arena
+ */
+
+void arena_free(Arena *a)
+{
+	struct arena_chunk *c;
+
+	while ((c = a->head) != NULL)
+	{
+		a->head = c->next;
+		free(c);
+	}
+	a->cur = NULL;
+}
+
+/**
+ * memstats_builtin - the "memstats" builtin, report line arena counters
+ * @args: argument vector
+ *
+ * "line mallocs" counts the chunks the current line had to allocate; it
+ * stays at 0 once the arena has warmed up.
+ * Return: 0
+ */
+
+int memstats_builtin(char **args __attribute__((unused)))
+{
+	struct arena_stats *st = &line_arena.stats;
+	char buf[256];
+
+	snprintf(buf, sizeof(buf),
+		 "arena chunks: %lu\narena reserved: %lu\narena high water: %lu\n"
+		 "lines: %lu\narena allocs: %lu\nline mallocs: %lu\n",
+		 st->chunk_mallocs, (unsigned long)st->reserved,
+		 (unsigned long)st->high_water, st->resets, st->allocs,
+		 st->line_mallocs);
+	_puts(buf);
+	return (0);
+}
@@ -0,0 +1,769 @@
+#include "shell.h"
+
+/*
+ * Integer arithmetic for $((...)), "let" and "((...))".  Expressions use
+ * the C operators on longs, plus '**' for powers; variables are read from
+ * and assigned to the shell variable store, and a variable whose value is
+ * not a number is evaluated as an expression itself.
+ *
+ * An expression is compiled once into an array of nodes by a precedence
+ * climbing parser and kept in a cache keyed by its text, so a loop body
+ * that evaluates the same text again only walks the tree.  The cache is
+ * emptied when it fills up, but only between top-level evaluations:
+ * while a variable's value is evaluated, the expression that refers to it
+ * is still being walked.
+ */
+
+#define ARITH_BUCKETS 64
+#define ARITH_CACHE_MAX 256
+#define ARITH_DEPTH_MAX 32
+
+enum arith_op {
+	A_NUM, A_VAR, A_COMMA, A_ASSIGN, A_COND, A_OR, A_AND, A_BOR, A_XOR,
+	A_BAND, A_EQ, A_NE, A_LT, A_LE, A_GT, A_GE, A_SHL, A_SHR, A_ADD, A_SUB,
+	A_MUL, A_DIV, A_MOD, A_POW, A_NEG, A_PLUS, A_NOT, A_COMPL, A_PREINC,
+	A_PREDEC, A_POSTINC, A_POSTDEC,
+	/* tokens that never become nodes */
+	T_END, T_LP, T_RP, T_QUEST, T_COLON, T_INC, T_DEC, T_BAD
+};
+
+struct arith_node {
+	enum arith_op op;
+	int a;
+	int b;
+	int c;
+	long num;
+};
+
+struct arith_expr {
+	struct arith_expr *next;
+	unsigned long hash;
+	size_t len;
+	int root;
+	struct arith_node *nodes;
+	char *src;
+};
+
+struct arith_parser {
+	const char *src;
+	const char *p;
+	const char *end;
+	enum arith_op tok;
+	enum arith_op assign_op;
+	long num;
+	const char *name;
+	struct arith_node *nodes;
+	int count;
+	int cap;
+	const char *error;
+};
+
+static struct arith_expr *arith_cache[ARITH_BUCKETS];
+static int arith_cached;
+
+static int parse_comma(struct arith_parser *ps);
+static int parse_assign(struct arith_parser *ps);
+static int parse_unary(struct arith_parser *ps);
+static int arith_run(const char *s, size_t len, int depth, long *result);
+
+/**
+ * lex_op - recognise an operator
+ * @ps: parser, positioned on the operator
+ * Return: the token; ps->p is moved past it
+ */
+
+static enum arith_op lex_op(struct arith_parser *ps)
+{
+	static const struct { const char *text; enum arith_op tok, assign; } ops[] = {
+		{"<<=", A_ASSIGN, A_SHL}, {">>=", A_ASSIGN, A_SHR}, {"**", A_POW, 0},
+		{"++", T_INC, 0}, {"--", T_DEC, 0}, {"<<", A_SHL, 0}, {">>", A_SHR, 0},
+		{"<=", A_LE, 0}, {">=", A_GE, 0}, {"==", A_EQ, 0}, {"!=", A_NE, 0},
+		{"&&", A_AND, 0}, {"||", A_OR, 0}, {"+=", A_ASSIGN, A_ADD},
+		{"-=", A_ASSIGN, A_SUB}, {"*=", A_ASSIGN, A_MUL}, {"/=", A_ASSIGN, A_DIV},
+		{"%=", A_ASSIGN, A_MOD}, {"&=", A_ASSIGN, A_BAND}, {"^=", A_ASSIGN, A_XOR},
+		{"|=", A_ASSIGN, A_BOR}, {"=", A_ASSIGN, A_NUM}, {"<", A_LT, 0},
+		{">", A_GT, 0}, {"+", A_ADD, 0}, {"-", A_SUB, 0}, {"*", A_MUL, 0},
+		{"/", A_DIV, 0}, {"%", A_MOD, 0}, {"&", A_BAND, 0}, {"^", A_XOR, 0},
+		{"|", A_BOR, 0}, {"!", A_NOT, 0}, {"~", A_COMPL, 0}, {"?", T_QUEST, 0},
+		{":", T_COLON, 0}, {",", A_COMMA, 0}, {"(", T_LP, 0}, {")", T_RP, 0}
+	};
+	size_t i, n;
+
+	for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+	{
+		n = strlen(ops[i].text);
+		if ((size_t)(ps->end - ps->p) >= n && memcmp(ps->p, ops[i].text, n) == 0)
+		{
+			ps->p += n;
+			ps->assign_op = ops[i].assign;
+			return (ops[i].tok);
+		}
+	}
+	return (T_BAD);
+}
+
+/**
+ * word_char - tell whether a byte can be part of a name or a number
+ * @c: byte
+ * Return: 1 if it can, 0 otherwise
+ */
+
+static int word_char(char c)
+{
+	return (c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		(c >= '0' && c <= '9'));
+}
+
+/**
+ * lex - read the next token
+ * @ps: parser
+ */
+
+static void lex(struct arith_parser *ps)
+{
+	const char *start;
+	char digits[72];
+	char *stop;
+	size_t n;
+
+	while (ps->p < ps->end && _isspace((unsigned char)*ps->p))
+		ps->p++;
+	if (ps->p == ps->end)
+	{
+		ps->tok = T_END;
+		return;
+	}
+	if (word_char(*ps->p) && !(*ps->p >= '0' && *ps->p <= '9'))
+	{
+		for (ps->name = ps->p; ps->p < ps->end && word_char(*ps->p); ps->p++)
+			;
+		ps->num = ps->p - ps->name;
+		ps->tok = A_VAR;
+		return;
+	}
+	if (*ps->p >= '0' && *ps->p <= '9')
+	{
+		for (start = ps->p; ps->p < ps->end && word_char(*ps->p); ps->p++)
+			;
+		n = ps->p - start;
+		if (n >= sizeof(digits))
+		{
+			ps->tok = T_BAD;
+			ps->error = "invalid number";
+			return;
+		}
+		memcpy(digits, start, n);
+		digits[n] = '\0';
+		errno = 0;
+		ps->num = strtol(digits, &stop, 0);
+		ps->tok = A_NUM;
+		if (*stop != '\0' || errno != 0)
+		{
+			ps->tok = T_BAD;
+			ps->error = "invalid number";
+		}
+		return;
+	}
+	ps->tok = lex_op(ps);
+}
+
+/**
+ * node_new - add a node to the tree being built
+ * @ps: parser
+ * @op: operation
+ * @a: first operand, or -1
+ * @b: second operand, or -1
+ * @c: third operand, or -1
+ * Return: index of the node, or -1 if memory is exhausted
+ */
+
+static int node_new(struct arith_parser *ps, enum arith_op op, int a, int b, int c)
+{
+	struct arith_node *tmp;
+
+	if (ps->count == ps->cap)
+	{
+		tmp = realloc(ps->nodes, (ps->cap ? ps->cap * 2 : 16) * sizeof(*tmp));
+		if (tmp == NULL)
+		{
+			ps->error = "out of memory";
+			return (-1);
+		}
+		ps->nodes = tmp;
+		ps->cap = ps->cap ? ps->cap * 2 : 16;
+	}
+	ps->nodes[ps->count].op = op;
+	ps->nodes[ps->count].a = a;
+	ps->nodes[ps->count].b = b;
+	ps->nodes[ps->count].c = c;
+	ps->nodes[ps->count].num = 0;
+	return (ps->count++);
+}
+
+/**
+ * syntax_error - record a syntax error
+ * @ps: parser
+ * Return: -1
+ */
+
+static int syntax_error(struct arith_parser *ps)
+{
+	if (ps->error == NULL)
+		ps->error = "syntax error";
+	return (-1);
+}
+
+/**
+ * parse_primary - number, variable or parenthesised expression, with any
+ * postfix "++" or "--"
+ * @ps: parser
+ * Return: node index, or -1
+ */
+
+static int parse_primary(struct arith_parser *ps)
+{
+	int n;
+
+	switch (ps->tok)
+	{
+	case A_NUM:
+		n = node_new(ps, A_NUM, -1, -1, -1);
+		if (n >= 0)
+			ps->nodes[n].num = ps->num;
+		lex(ps);
+		return (n);
+	case A_VAR:
+		/* the name is kept as an offset into the source text */
+		n = node_new(ps, A_VAR, ps->name - ps->src, ps->num, -1);
+		lex(ps);
+		if (n >= 0 && (ps->tok == T_INC || ps->tok == T_DEC))
+		{
+			n = node_new(ps, ps->tok == T_INC ? A_POSTINC : A_POSTDEC, n, -1, -1);
+			lex(ps);
+		}
+		return (n);
+	case T_LP:
+		lex(ps);
+		n = parse_comma(ps);
+		if (n < 0 || ps->tok != T_RP)
+			return (syntax_error(ps));
+		lex(ps);
+		return (n);
+	default:
+		return (syntax_error(ps));
+	}
+}
+
+/**
+ * parse_unary - prefix operators
+ * @ps: parser
+ * Return: node index, or -1
+ */
+
+static int parse_unary(struct arith_parser *ps)
+{
+	enum arith_op op = ps->tok;
+	int n;
+
+	switch (op)
+	{
+	case A_SUB:
+	case A_ADD:
+	case A_NOT:
+	case A_COMPL:
+		lex(ps);
+		n = parse_unary(ps);
+		if (n < 0)
+			return (-1);
+		return (node_new(ps, op == A_SUB ? A_NEG : op == A_ADD ? A_PLUS : op, n, -1, -1));
+	case T_INC:
+	case T_DEC:
+		lex(ps);
+		if (ps->tok != A_VAR)
+			return (syntax_error(ps));
+		n = node_new(ps, A_VAR, ps->name - ps->src, ps->num, -1);
+		lex(ps);
+		if (n < 0)
+			return (-1);
+		return (node_new(ps, op == T_INC ? A_PREINC : A_PREDEC, n, -1, -1));
+	default:
+		return (parse_primary(ps));
+	}
+}
+
+/**
+ * binary_prec - precedence of a binary operator
+ * @op: token
+ * Return: precedence, higher binds tighter; 0 if @op is not binary
+ */
+
+static int binary_prec(enum arith_op op)
+{
+	switch (op)
+	{
+	case A_OR:
+		return (1);
+	case A_AND:
+		return (2);
+	case A_BOR:
+		return (3);
+	case A_XOR:
+		return (4);
+	case A_BAND:
+		return (5);
+	case A_EQ:
+	case A_NE:
+		return (6);
+	case A_LT:
+	case A_LE:
+	case A_GT:
+	case A_GE:
+		return (7);
+	case A_SHL:
+	case A_SHR:
+		return (8);
+	case A_ADD:
+	case A_SUB:
+		return (9);
+	case A_MUL:
+	case A_DIV:
+	case A_MOD:
+		return (10);
+	case A_POW:
+		return (11);
+	default:
+		return (0);
+	}
+}
+
+/**
+ * parse_binary - binary operators of at least a given precedence
+ * @ps: parser
+ * @min: lowest precedence to take
+ * Return: node index, or -1
+ */
+
+static int parse_binary(struct arith_parser *ps, int min)
+{
+	enum arith_op op;
+	int lhs = parse_unary(ps), rhs, prec;
+
+	while (lhs >= 0 && (prec = binary_prec(ps->tok)) >= min && prec > 0)
+	{
+		op = ps->tok;
+		lex(ps);
+		/* '**' groups to the right, everything else to the left */
+		rhs = parse_binary(ps, op == A_POW ? prec : prec + 1);
+		if (rhs < 0)
+			return (-1);
+		lhs = node_new(ps, op, lhs, rhs, -1);
+	}
+	return (lhs);
+}
+
+/**
+ * parse_cond - the conditional operator
+ * @ps: parser
+ * Return: node index, or -1
+ */
+
+static int parse_cond(struct arith_parser *ps)
+{
+	int c = parse_binary(ps, 1), t, f;
+
+	if (c < 0 || ps->tok != T_QUEST)
+		return (c);
+	lex(ps);
+	t = parse_assign(ps);
+	if (t < 0 || ps->tok != T_COLON)
+		return (syntax_error(ps));
+	lex(ps);
+	f = parse_cond(ps);
+	if (f < 0)
+		return (-1);
+	return (node_new(ps, A_COND, c, t, f));
+}
+
+/**
+ * parse_assign - assignment operators, grouping to the right
+ * @ps: parser
+ * Return: node index, or -1
+ */
+
+static int parse_assign(struct arith_parser *ps)
+{
+	int lhs = parse_cond(ps), rhs;
+	enum arith_op op;
+
+	if (lhs < 0 || ps->tok != A_ASSIGN)
+		return (lhs);
+	if (ps->nodes[lhs].op != A_VAR)
+	{
+		ps->error = "attempted assignment to non-variable";
+		return (-1);
+	}
+	op = ps->assign_op;
+	lex(ps);
+	rhs = parse_assign(ps);
+	if (rhs < 0)
+		return (-1);
+	return (node_new(ps, A_ASSIGN, lhs, rhs, op));
+}
+
+/**
+ * parse_comma - the comma operator
+ * @ps: parser
+ * Return: node index, or -1
+ */
+
+static int parse_comma(struct arith_parser *ps)
+{
+	int lhs = parse_assign(ps), rhs;
+
+	while (lhs >= 0 && ps->tok == A_COMMA)
+	{
+		lex(ps);
+		rhs = parse_assign(ps);
+		if (rhs < 0)
+			return (-1);
+		lhs = node_new(ps, A_COMMA, lhs, rhs, -1);
+	}
+	return (lhs);
+}
+
+/**
+ * arith_compile - compile an expression, or find it in the cache
+ * @s: expression text
+ * @len: length of @s
+ * @depth: nesting depth, see arith_run(); the cache may only be emptied
+ * at depth 0, when no compiled expression is in use
+ * @error: receives the message if the expression does not compile
+ * Return: the compiled expression, or NULL
+ */
+
+static struct arith_expr *arith_compile(const char *s, size_t len, int depth,
+					const char **error)
+{
+	unsigned long h = 2166136261UL;
+	struct arith_expr *e, *next;
+	struct arith_parser ps;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)s[i]) * 16777619UL;
+	for (e = arith_cache[h % ARITH_BUCKETS]; e != NULL; e = e->next)
+	{
+		if (e->hash == h && e->len == len && memcmp(e->src, s, len) == 0)
+			return (e);
+	}
+
+	_memset((char *)&ps, 0, sizeof(ps));
+	ps.src = ps.p = s;
+	ps.end = s + len;
+	lex(&ps);
+	e = NULL;
+	i = ps.tok == T_END ? (size_t)node_new(&ps, A_NUM, -1, -1, -1) : (size_t)parse_comma(&ps);
+	if (ps.error == NULL && ps.tok != T_END)
+		syntax_error(&ps);
+	if (ps.error == NULL)
+	{
+		e = malloc(sizeof(*e) + ps.count * sizeof(*ps.nodes) + len + 1);
+		if (e == NULL)
+			ps.error = "out of memory";
+	}
+	if (e == NULL)
+	{
+		free(ps.nodes);
+		*error = ps.error;
+		return (NULL);
+	}
+
+	if (arith_cached >= ARITH_CACHE_MAX && depth == 0)
+	{
+		for (i = 0; i < ARITH_BUCKETS; i++)
+		{
+			for (; arith_cache[i] != NULL; arith_cache[i] = next)
+			{
+				next = arith_cache[i]->next;
+				free(arith_cache[i]);
+			}
+		}
+		arith_cached = 0;
+	}
+	e->hash = h;
+	e->len = len;
+	e->root = ps.count - 1;
+	e->nodes = (struct arith_node *)(e + 1);
+	memcpy(e->nodes, ps.nodes, ps.count * sizeof(*ps.nodes));
+	e->src = (char *)(e->nodes + ps.count);
+	memcpy(e->src, s, len);
+	e->src[len] = '\0';
+	e->next = arith_cache[h % ARITH_BUCKETS];
+	arith_cache[h % ARITH_BUCKETS] = e;
+	arith_cached++;
+	free(ps.nodes);
+	return (e);
+}
+
+struct arith_eval {
+	struct arith_expr *e;
+	int depth;
+	const char *error;
+};
+
+/**
+ * var_value - the numeric value of a variable
+ * @ev: evaluation state
+ * @node: the A_VAR node
+ * Return: the value; unset and empty variables are 0
+ */
+
+static long var_value(struct arith_eval *ev, struct arith_node *node)
+{
+	char *s = var_getn(ev->e->src + node->a, node->b), *end;
+	long n;
+
+	if (s == NULL || *s == '\0')
+		return (0);
+	errno = 0;
+	n = strtol(s, &end, 0);
+	if (*end == '\0' && errno == 0)
+		return (n);
+	if (ev->depth >= ARITH_DEPTH_MAX)
+	{
+		ev->error = "expression recursion level exceeded";
+		return (0);
+	}
+	if (arith_run(s, strlen(s), ev->depth + 1, &n) != 0)
+	{
+		ev->error = "";
+		return (0);
+	}
+	return (n);
+}
+
+/**
+ * var_assign_num - store a number in a variable
+ * @ev: evaluation state
+ * @node: the A_VAR node
+ * @n: value
+ * Return: @n
+ */
+
+static long var_assign_num(struct arith_eval *ev, struct arith_node *node, long n)
+{
+	char buf[24];
+
+	snprintf(buf, sizeof(buf), "%ld", n);
+	if (var_setn(ev->e->src + node->a, node->b, buf, 0) != 0)
+		ev->error = "out of memory";
+	return (n);
+}
+
+/**
+ * arith_binary - apply a binary operator
+ * @ev: evaluation state
+ * @op: operator
+ * @a: left operand
+ * @b: right operand
+ * Return: result; signed overflow wraps around
+ */
+
+static long arith_binary(struct arith_eval *ev, enum arith_op op, long a, long b)
+{
+	unsigned long r;
+
+	switch (op)
+	{
+	case A_BOR: return (a | b);
+	case A_XOR: return (a ^ b);
+	case A_BAND: return (a & b);
+	case A_EQ: return (a == b);
+	case A_NE: return (a != b);
+	case A_LT: return (a < b);
+	case A_LE: return (a <= b);
+	case A_GT: return (a > b);
+	case A_GE: return (a >= b);
+	case A_SHL: return ((long)((unsigned long)a << (b & 63)));
+	case A_SHR: return (a >> (b & 63));
+	case A_ADD: return ((long)((unsigned long)a + (unsigned long)b));
+	case A_SUB: return ((long)((unsigned long)a - (unsigned long)b));
+	case A_MUL: return ((long)((unsigned long)a * (unsigned long)b));
+	case A_DIV:
+	case A_MOD:
+		if (b == 0)
+		{
+			ev->error = "division by 0";
+			return (0);
+		}
+		if (b == -1)
+			return (op == A_DIV ? (long)(0UL - (unsigned long)a) : 0);
+		return (op == A_DIV ? a / b : a % b);
+	case A_POW:
+		if (b < 0)
+		{
+			ev->error = "exponent less than 0";
+			return (0);
+		}
+		for (r = 1; b > 0; b >>= 1, a = (long)((unsigned long)a * (unsigned long)a))
+		{
+			if (b & 1)
+				r *= (unsigned long)a;
+		}
+		return ((long)r);
+	default:
+		return (0);
+	}
+}
+
+/**
+ * arith_node_eval - evaluate a subtree
+ * @ev: evaluation state; ev->error is set on failure
+ * @i: node index
+ * Return: value
+ */
+
+static long arith_node_eval(struct arith_eval *ev, int i)
+{
+	struct arith_node *n = &ev->e->nodes[i], *var;
+	long a, b;
+
+	switch (n->op)
+	{
+	case A_NUM:
+		return (n->num);
+	case A_VAR:
+		return (var_value(ev, n));
+	case A_COMMA:
+		arith_node_eval(ev, n->a);
+		return (arith_node_eval(ev, n->b));
+	case A_COND:
+		a = arith_node_eval(ev, n->a);
+		return (arith_node_eval(ev, a ? n->b : n->c));
+	case A_OR:
+		return (arith_node_eval(ev, n->a) || arith_node_eval(ev, n->b));
+	case A_AND:
+		return (arith_node_eval(ev, n->a) && arith_node_eval(ev, n->b));
+	case A_NEG:
+		return ((long)(0UL - (unsigned long)arith_node_eval(ev, n->a)));
+	case A_PLUS:
+		return (arith_node_eval(ev, n->a));
+	case A_NOT:
+		return (!arith_node_eval(ev, n->a));
+	case A_COMPL:
+		return (~arith_node_eval(ev, n->a));
+	case A_PREINC:
+	case A_PREDEC:
+	case A_POSTINC:
+	case A_POSTDEC:
+		var = &ev->e->nodes[n->a];
+		a = var_value(ev, var);
+		b = (long)((unsigned long)a + (n->op == A_PREINC || n->op == A_POSTINC ? 1UL : ~0UL));
+		var_assign_num(ev, var, b);
+		return (n->op == A_PREINC || n->op == A_PREDEC ? b : a);
+	case A_ASSIGN:
+		var = &ev->e->nodes[n->a];
+		b = arith_node_eval(ev, n->b);
+		if (n->c != A_NUM)
+			b = arith_binary(ev, (enum arith_op)n->c, var_value(ev, var), b);
+		return (ev->error ? 0 : var_assign_num(ev, var, b));
+	default:
+		a = arith_node_eval(ev, n->a);
+		b = arith_node_eval(ev, n->b);
+		return (arith_binary(ev, n->op, a, b));
+	}
+}
+
+/**
+ * arith_run - evaluate an expression at a given nesting depth
+ * @s: expression text
+ * @len: length of @s
+ * @depth: how many variables deep the evaluation is
+ * @result: receives the value
+ * Return: 0, or -1 on failure, which has been reported
+ */
+
+static int arith_run(const char *s, size_t len, int depth, long *result)
+{
+	struct arith_eval ev;
+	const char *error = NULL;
+
+	ev.e = arith_compile(s, len, depth, &error);
+	ev.depth = depth;
+	ev.error = NULL;
+	if (ev.e != NULL)
+		*result = arith_node_eval(&ev, ev.e->root);
+	else
+		ev.error = error;
+	if (ev.error == NULL)
+		return (0);
+	if (*ev.error != '\0')
+	{
+		_puts_fd(STDERR_FILENO, "hsh: ");
+		_write_buf(STDERR_FILENO, s, len);
+		_puts_fd(STDERR_FILENO, ": ");
+		_puts_fd(STDERR_FILENO, (char *)ev.error);
+		_puts_fd(STDERR_FILENO, "\n");
+	}
+	return (-1);
+}
+
+/**
+ * arith_eval - evaluate an arithmetic expression
+ * @s: expression text, not necessarily terminated
+ * @len: length of @s
+ * @result: receives the value
+ * Return: 0, or -1 on failure, which has been reported
+ */
+
+int arith_eval(const char *s, size_t len, long *result)
+{
+	return (arith_run(s, len, 0, result));
+}
+
+/**
+ * let_builtin - the "let" builtin
+ * @args: argument vector: one expression per argument
+ * Return: 0 if the last expression is non-zero, 1 if it is zero or an
+ * expression fails
+ */
+
+int let_builtin(char **args)
+{
+	long n = 0;
+
+	if (args[1] == NULL)
+	{
+		_puts_fd(STDERR_FILENO, "let: expression expected\n");
+		return (1);
+	}
+	for (args++; *args != NULL; args++)
+	{
+		if (arith_eval(*args, strlen(*args), &n) != 0)
+			return (1);
+	}
+	return (n == 0);
+}
+
+/**
+ * arith_command_builtin - a "((expression))" command
+ * @args: argument vector; args[0] is the whole "((...))" word
+ * Return: as for "let"; 2 if the word is not closed by "))"
+ */
+
+int arith_command_builtin(char **args)
+{
+	size_t len = strlen(args[0]);
+	long n;
+
+	if (len < 4 || args[0][len - 1] != ')' || args[0][len - 2] != ')' || args[1] != NULL)
+	{
+		_puts_fd(STDERR_FILENO, "hsh: ");
+		_puts_fd(STDERR_FILENO, args[0]);
+		_puts_fd(STDERR_FILENO, ": syntax error\n");
+		return (2);
+	}
+	if (arith_eval(args[0] + 2, len - 4, &n) != 0)
+		return (1);
+	return (n == 0);
+}
@@ -0,0 +1,183 @@
+#include "shell.h"
+#include <sys/mman.h>
+
+/*
+ * Non-interactive input.  No prompt is printed and lines are tokenized
+ * where they lie: in a private mapping of the script, or in one large
+ * read buffer for pipes.  Both are writable because the tokenizer
+ * terminates words in place.
+ */
+
+/**
+ * run_buffer - run every complete line of a buffer
+ * @buf: buffer
+ * @len: number of bytes in @buf
+ * Return: number of bytes consumed; an unterminated last line is left
+ */
+
+static size_t run_buffer(char *buf, size_t len)
+{
+	char *line = buf, *end = buf + len, *nl;
+
+	while (line < end && (nl = memchr(line, '\n', end - line)) != NULL)
+	{
+		*nl = '\0';
+		run_line(line, 0);
+		line = nl + 1;
+	}
+	return (line - buf);
+}
+
+/**
+ * run_fd - run commands read from a descriptor in large chunks
+ * @fd: descriptor, usually a pipe on stdin
+ * Return: 0
+ */
+
+int run_fd(int fd)
+{
+	size_t cap = BATCH_BUF_SIZE, len = 0, used;
+	char *buf = malloc(cap + 1), *tmp;
+	ssize_t n;
+	long t0;
+
+	if (buf == NULL)
+	{
+		_perror("malloc");
+		return (1);
+	}
+
+	while (1)
+	{
+		if (len == cap)
+		{
+			tmp = realloc(buf, cap * 2 + 1);
+			if (tmp == NULL)
+			{
+				_perror("realloc");
+				break;
+			}
+			buf = tmp;
+			cap *= 2;
+		}
+		t0 = trace_begin();
+		n = read(fd, buf + len, cap - len);
+		trace_end("read", NULL, t0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		len += n;
+		used = run_buffer(buf, len);
+		len -= used;
+		if (len > 0 && used > 0)
+			memmove(buf, buf + used, len);
+	}
+
+	if (len > 0)
+	{
+		buf[len] = '\0';
+		run_line(buf, 0);
+	}
+	free(buf);
+	return (0);
+}
+
+/**
+ * run_script - run a script file through a private mapping
+ * @path: script path
+ *
+ * With HSH_CACHE_DIR set the script goes through the compiled-script
+ * cache instead.  When the file does not end on a page boundary, the mapping already has
+ * room for a terminator after the last byte; otherwise an unterminated
+ * last line is copied out before it is run.
+ * Return: 0, or 127 if the script cannot be opened
+ */
+
+int run_script(const char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	size_t size, done;
+	long page = sysconf(_SC_PAGESIZE);
+	char *map, *last;
+
+	if (fd < 0)
+	{
+		_perror((char *)path);
+		return (127);
+	}
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+	{
+		run_fd(fd);
+		close(fd);
+		return (0);
+	}
+	if (scriptcache_run(path, fd, &st) == 0)
+	{
+		close(fd);
+		return (0);
+	}
+
+	size = st.st_size;
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return (127);
+		run_fd(fd);
+		close(fd);
+		return (0);
+	}
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	done = run_buffer(map, size);
+	if (done < size)
+	{
+		if (size % page != 0)
+		{
+			map[size] = '\0';
+			run_line(map + done, 0);
+		}
+		else
+		{
+			last = malloc(size - done + 1);
+			if (last != NULL)
+			{
+				memcpy(last, map + done, size - done);
+				last[size - done] = '\0';
+				run_line(last, 0);
+				free(last);
+			}
+		}
+	}
+	munmap(map, size);
+	return (0);
+}
+
+/**
+ * run_string - run a -c command string
+ * @s: command string, modified in place
+ *
+ * The last line is run with EXEC_TAIL, so when it is a lone external
+ * command the shell execs it directly instead of forking and waiting.
+ * Return: 0
+ */
+
+int run_string(char *s)
+{
+	char *nl;
+
+	while ((nl = strchr(s, '\n')) != NULL && nl[1] != '\0')
+	{
+		*nl = '\0';
+		run_line(s, 0);
+		s = nl + 1;
+	}
+	if (nl != NULL)
+		*nl = '\0';
+	run_line(s, EXEC_TAIL);
+	return (0);
+}
@@ -0,0 +1,175 @@
+#include "shell.h"
+
+/**
+ * builtin_exit - the "exit" and "quit" builtins
+ * @args: argument vector
+ * Return: does not return
+ */
+
+static int builtin_exit(char **args)
+{
+	exit(args[1] ? atoi(args[1]) : last_status);
+}
+
+/**
+ * builtin_author - print the author of the shell
+ * @args: argument vector
+ * Return: 0
+ */
+
+static int builtin_author(char **args __attribute__((unused)))
+{
+	_puts("Innocent Ingabire\n");
+	return (0);
+}
+
+/**
+ * builtin_true - the "true" and ":" builtins
+ * @args: argument vector
+ * Return: 0
+ */
+
+static int builtin_true(char **args __attribute__((unused)))
+{
+	return (0);
+}
+
+/**
+ * builtin_false - the "false" builtin
+ * @args: argument vector
+ * Return: 1
+ */
+
+static int builtin_false(char **args __attribute__((unused)))
+{
+	return (1);
+}
+
+/**
+ * builtin_cd - change the working directory
+ * @args: argument vector
+ * Return: 0 on success, 1 on error
+ */
+
+static int builtin_cd(char **args)
+{
+	char *dir = var_get("HOME");
+
+	if (args[1] && _strcmp(args[1], "~") != 0)
+		dir = args[1];
+	if (dir == NULL || chdir(dir) != 0)
+	{
+		_perror("cd");
+		return (1);
+	}
+	return (0);
+}
+
+/**
+ * builtin_pwd - print the working directory
+ * @args: argument vector
+ * Return: 0 on success, 1 on error
+ */
+
+static int builtin_pwd(char **args __attribute__((unused)))
+{
+	char cwd[PATH_MAX];
+
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+	{
+		_perror("pwd");
+		return (1);
+	}
+	_puts(cwd);
+	_puts("\n");
+	return (0);
+}
+
+/*
+ * Sorted by name for builtin_lookup().  BI_SUBSHELL marks builtins that
+ * touch shell state or write to stdout and therefore run in a forked
+ * subshell when they are one stage of a multi-stage pipeline; on their
+ * own they always run in the shell process.  An in-shell stage runs
+ * before the stages after it are started, so it must not write to its
+ * pipe; the others write nothing to stdout, and "true | cat" starts a
+ * single process.  "wait" must see the shell's own children, so it never
+ * leaves it.  BI_JOBS gives the subshell of "jobs" a snapshot of the job
+ * table instead of an empty one.
+ * BI_PURE marks builtins that only read shell state and write to stdout,
+ * which command substitution can therefore run in the shell process.
+ * "jobs" is not one of them: it forgets the jobs it reports as done.
+ */
+static const struct builtin builtins[] = {
+	{":", builtin_true, BI_PURE},
+	{"[", test_builtin, BI_PURE},
+	{"author", builtin_author, BI_SUBSHELL | BI_PURE},
+	{"cd", builtin_cd, BI_SUBSHELL},
+	{"echo", echo_builtin, BI_SUBSHELL | BI_PURE},
+	{"exit", builtin_exit, BI_SUBSHELL},
+	{"export", export_builtin, BI_SUBSHELL},
+	{"false", builtin_false, BI_PURE},
+	{"hash", hash_builtin, BI_SUBSHELL},
+	{"jobs", jobs_builtin, BI_SUBSHELL | BI_JOBS},
+	{"let", let_builtin, BI_SUBSHELL},
+	{"linecache", linecache_builtin, BI_SUBSHELL},
+	{"memstats", memstats_builtin, BI_SUBSHELL | BI_PURE},
+	{"parallel", parallel_builtin, BI_SUBSHELL},
+	{"printf", printf_builtin, BI_SUBSHELL | BI_PURE},
+	{"pwd", builtin_pwd, BI_SUBSHELL | BI_PURE},
+	{"quit", builtin_exit, BI_SUBSHELL},
+	{"set", set_builtin, BI_SUBSHELL},
+	{"test", test_builtin, BI_PURE},
+	{"true", builtin_true, BI_PURE},
+	{"unset", unset_builtin, BI_SUBSHELL},
+	{"wait", wait_builtin, 0}
+};
+
+/*
+ * BI_SYNTAX marks the two commands recognised by the shape of the word as
+ * written, which an expansion producing the same text does not make.
+ */
+
+/* a command whose first word is "name=value" */
+static const struct builtin assign = {"name=value", assign_builtin, BI_SUBSHELL | BI_SYNTAX};
+
+/* a "((expression))" command */
+static const struct builtin arith_command = {"((", arith_command_builtin, BI_SUBSHELL | BI_SYNTAX};
+
+/**
+ * builtin_cmp - bsearch comparator between a name and a table entry
+ * @key: name
+ * @entry: table entry
+ * Return: strcmp-style ordering
+ */
+
+static int builtin_cmp(const void *key, const void *entry)
+{
+	return (strcmp(key, ((const struct builtin *)entry)->name));
+}
+
+/**
+ * builtin_lookup - find the builtin for a command word as written
+ * @name: command name
+ * Return: the table entry, or NULL if @name is not a builtin
+ */
+
+const struct builtin *builtin_lookup(const char *name)
+{
+	if (var_is_assignment(name))
+		return (&assign);
+	if (name[0] == '(' && name[1] == '(')
+		return (&arith_command);
+	return (builtin_find(name));
+}
+
+/**
+ * builtin_find - find a builtin by name only
+ * @name: command name, such as the result of an expansion
+ * Return: the table entry, or NULL if @name is not a builtin
+ */
+
+const struct builtin *builtin_find(const char *name)
+{
+	return (bsearch(name, builtins, sizeof(builtins) / sizeof(builtins[0]),
+			sizeof(builtins[0]), builtin_cmp));
+}
@@ -3,107 +3,139 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define DEBUG
-const CListElementType INVALID_RETURN = {TOK_END, NULL};
-
-struct _cl_node
-{
-    CListElementType element;
-    struct _cl_node *next;
-};
+const CListElementType INVALID_RETURN = {TOK_END, NULL, 0, 0};
 
+/*
+ * A CList is a growable array.  Live elements are
+ * elements[head .. head + length - 1]; popping from the front only moves
+ * head, so consuming a token list from the front is O(1) per token.
+ */
 struct _clist
 {
-    struct _cl_node *head;
+    CListElementType *elements;
+    int head;
     int length;
+    int capacity;
+    Arena *arena;
 };
 
-static struct _cl_node *
+#define CL_MIN_CAPACITY 8
 
-_CL_new_node(CListElementType element, struct _cl_node *next)
+static bool _CL_reserve(CList list, int extra)
 {
-    struct _cl_node *new = (struct _cl_node *)malloc(sizeof(struct _cl_node));
+    int needed = list->length + extra;
+    int capacity;
+    CListElementType *elements;
+
+    if (list->head + needed <= list->capacity)
+    {
+        return true;
+    }
+
+    /* plenty of dead space at the front: slide down instead of growing */
+    if (needed <= list->capacity && list->head >= list->capacity / 2)
+    {
+        memmove(list->elements, list->elements + list->head,
+                list->length * sizeof(CListElementType));
+        list->head = 0;
+        return true;
+    }
+
+    capacity = list->capacity ? list->capacity : CL_MIN_CAPACITY;
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
 
-    new->element = element;
-    new->next = next;
+    if (list->arena != NULL)
+    {
+        elements = arena_alloc(list->arena, capacity * sizeof(CListElementType));
+        if (elements == NULL)
+        {
+            return false;
+        }
+        if (list->length > 0)
+        {
+            memcpy(elements, list->elements + list->head,
+                   list->length * sizeof(CListElementType));
+        }
+    }
+    else
+    {
+        if (list->head > 0)
+        {
+            memmove(list->elements, list->elements + list->head,
+                    list->length * sizeof(CListElementType));
+        }
+        elements = realloc(list->elements, capacity * sizeof(CListElementType));
+        if (elements == NULL)
+        {
+            list->head = 0;
+            return false;
+        }
+    }
 
-    return new;
+    list->elements = elements;
+    list->head = 0;
+    list->capacity = capacity;
+    return true;
 }
 
-CList CL_new()
+CList CL_new(Arena *arena)
 {
-    CList list = (CList)malloc(sizeof(struct _clist));
+    CList list;
+
+    if (arena != NULL)
+        list = arena_alloc(arena, sizeof(struct _clist));
+    else
+        list = (CList)malloc(sizeof(struct _clist));
+    if (list == NULL)
+        return NULL;
 
-    list->head = NULL;
+    list->elements = NULL;
+    list->head = 0;
     list->length = 0;
+    list->capacity = 0;
+    list->arena = arena;
 
     return list;
 }
 
 void CL_free(CList list)
 {
-    struct _cl_node *current;
-    if (list == NULL)
+    if (list == NULL || list->arena != NULL)
     {
         return;
     }
 
-    while ((current = list->head) != NULL)
-    {
-        list->head = current->next;
-        free(current);
-    }
-
+    free(list->elements);
     free(list);
 }
 
 int CL_length(CList list)
 {
-
-#ifdef DEBUG
-
-    int len = 0;
-    struct _cl_node *node;
-    for (node = list->head; node != NULL; node = node->next)
-        len++;
-
-#endif
-
     return list->length;
 }
 
 CListElementType CL_pop(CList list)
 {
-
-    struct _cl_node *popped_node = list->head;
     CListElementType ret;
 
-    if (popped_node == NULL)
+    if (list->length == 0)
         return INVALID_RETURN;
 
-    ret = popped_node->element;
-
-    list->head = popped_node->next;
-    free(popped_node);
-
+    ret = list->elements[list->head];
     list->length--;
+    list->head = list->length ? list->head + 1 : 0;
 
     return ret;
 }
 
 bool CL_insert(CList list, CListElementType element, int pos)
 {
+    int len = list->length;
 
-    int len;
-    int i = 0;
-    struct _cl_node *curr = list->head;
-    struct _cl_node *prev = NULL;
-    struct _cl_node *new_node = _CL_new_node(element, NULL);
-
-    len = CL_length(list);
-
-    
-    if (pos <= (-1 * len) || pos > len)
+    if (pos < -(len + 1) || pos > len)
     {
         return false;
     }
@@ -113,104 +145,60 @@ bool CL_insert(CList list, CListElementType element, int pos)
         pos = len + pos + 1;
     }
 
-    i = 0;
-    curr = list->head;
-    prev = NULL;
-    new_node = _CL_new_node(element, NULL);
-
-    if (new_node == NULL)
+    if (pos == 0 && list->head > 0)
     {
-        return false;
-    }
-
-    if (pos == 0)
-    {
-        new_node->next = list->head;
-        list->head = new_node;
+        list->head--;
+        list->elements[list->head] = element;
         list->length++;
         return true;
     }
 
-    while (curr != NULL && i < pos)
+    if (!_CL_reserve(list, 1))
     {
-        prev = curr;
-        curr = curr->next;
-        i++;
+        return false;
     }
 
-    new_node->next = curr;
-    prev->next = new_node;
+    memmove(list->elements + list->head + pos + 1,
+            list->elements + list->head + pos,
+            (len - pos) * sizeof(CListElementType));
+    list->elements[list->head + pos] = element;
     list->length++;
 
     return true;
 }
+
 CList CL_copy(CList list)
 {
+    CList copy = CL_new(list->arena);
 
-    CList copy = CL_new();
-
-    struct _cl_node *curr = list->head;
-    struct _cl_node *currcpy = NULL;
-
-    while (curr != NULL)
+    if (copy == NULL || !_CL_reserve(copy, list->length))
     {
-
-        struct _cl_node *new_node = _CL_new_node(curr->element, NULL);
-
-        if (copy->head == NULL)
-        {
-
-            copy->head = new_node;
-            currcpy = new_node;
-        }
-        else
-        {
-            currcpy->next = new_node;
-            currcpy = new_node;
-        }
-        curr = curr->next;
-        copy->length++;
+        return copy;
     }
+    memcpy(copy->elements, list->elements + list->head,
+           list->length * sizeof(CListElementType));
+    copy->length = list->length;
     return copy;
 }
+
 void CL_push(CList list, CListElementType element)
 {
-
-    list->head = _CL_new_node(element, list->head);
-    list->length++;
+    CL_insert(list, element, 0);
 }
+
 void CL_append(CList list, CListElementType element)
 {
-
-    struct _cl_node *new_node = _CL_new_node(element, NULL);
-    if (!new_node)
+    if (!_CL_reserve(list, 1))
     {
         return;
     }
-
-    if (list->head == NULL)
-    {
-        list->head = new_node;
-    }
-    else
-    {
-        struct _cl_node *curr = list->head;
-
-        while (curr->next != NULL)
-        {
-            curr = curr->next;
-        }
-        curr->next = new_node;
-    }
+    list->elements[list->head + list->length] = element;
     list->length++;
 }
 
 CListElementType CL_nth(CList list, int pos)
 {
-
     int length = list->length;
-    int i = 0;
-    struct _cl_node *curr = list->head;
 
     if (pos < -length || pos >= length)
     {
@@ -222,27 +210,12 @@ CListElementType CL_nth(CList list, int pos)
         pos = length + pos;
     }
 
-    
-
-    while (curr != NULL)
-    {
-        if (i == pos)
-        {
-            return curr->element;
-        }
-        curr = curr->next;
-        i++;
-    }
-
-    return INVALID_RETURN;
+    return list->elements[list->head + pos];
 }
 
 CListElementType CL_remove(CList list, int pos)
 {
-    int i;
-    int len = CL_length(list);
-    struct _cl_node *curr = list->head;
-    struct _cl_node *prev = NULL;
+    int len = list->length;
     CListElementType removedElement;
 
     if (pos < -len || pos >= len)
@@ -255,94 +228,53 @@ CListElementType CL_remove(CList list, int pos)
         pos += len;
     }
 
-    
-
-    if (!curr)
-    {
-        return INVALID_RETURN;
-    }
-
     if (pos == 0)
     {
-        list->head = curr->next;
-        removedElement = curr->element;
-        free(curr);
-        list->length--;
-        return removedElement;
+        return CL_pop(list);
     }
 
-    for (i = 0; curr != NULL && i < pos; i++)
-    {
-        prev = curr;
-        curr = curr->next;
-    }
-
-    if (curr)
-    {
-        if (prev)
-        {
-            prev->next = curr->next;
-        }
-        removedElement = curr->element;
-        free(curr);
-        list->length--;
-        return removedElement;
-    }
-    return INVALID_RETURN;
+    removedElement = list->elements[list->head + pos];
+    memmove(list->elements + list->head + pos,
+            list->elements + list->head + pos + 1,
+            (len - pos - 1) * sizeof(CListElementType));
+    list->length--;
+    return removedElement;
 }
 
 void CL_join(CList list1, CList list2)
 {
-
-    if (list1->head == NULL)
+    if (list2->length > 0 && _CL_reserve(list1, list2->length))
     {
-        list1->head = list2->head;
+        memcpy(list1->elements + list1->head + list1->length,
+               list2->elements + list2->head,
+               list2->length * sizeof(CListElementType));
+        list1->length += list2->length;
     }
-    else
-    {
-        struct _cl_node *curr = list1->head;
-
-        while (curr->next != NULL)
-        {
-            curr = curr->next;
-        }
 
-        curr->next = list2->head;
-    }
-
-    list1->length += list2->length;
-
-    list2->head = NULL;
+    list2->head = 0;
     list2->length = 0;
 }
 
 void CL_reverse(CList list)
 {
+    CListElementType *lo = list->elements + list->head;
+    CListElementType *hi = lo + list->length - 1;
+    CListElementType tmp;
 
-    struct _cl_node *p2 = list->head;
-    struct _cl_node *p1 = NULL;
-    struct _cl_node *p3;
-
-    while (p2 != NULL)
+    while (lo < hi)
     {
-        p3 = p2->next;
-        p2->next = p1;
-        p1 = p2;
-        p2 = p3;
+        tmp = *lo;
+        *lo++ = *hi;
+        *hi-- = tmp;
     }
-    list->head = p1;
 }
 
 void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data)
 {
+    int pos;
 
-    struct _cl_node *curr = list->head;
-    int pos = 0;
-
-    while (curr != NULL)
+    for (pos = 0; pos < list->length; pos++)
     {
-        callback(pos, curr->element, cb_data);
-        curr = curr->next;
-        pos++;
+        callback(pos, list->elements[list->head + pos], cb_data);
     }
-}
\ No newline at end of file
+}
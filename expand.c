@@ -0,0 +1,533 @@
+#include "shell.h"
+
+/*
+ * Parameter expansion, done when a pipeline runs rather than when it is
+ * parsed, so cached lines see the variables of the moment.
+ *
+ *	$name ${name}		value, or nothing when unset
+ *	${name:-word} ${name-word}	value, or word when unset (or empty)
+ *	${name:=word} ${name=word}	the same, also assigning word
+ *	${name:+word} ${name+word}	word when set (and not empty)
+ *	${name:?word} ${name?word}	value, or an error when unset
+ *	${#name}		length of the value
+ *	$? $$ $!		last status, shell pid, last background pid
+ *	$((expression))		value of an arithmetic expression, whose
+ *				parameters are expanded first
+ *	$(command)		output of a command list, less its trailing
+ *				newlines
+ *	${PIPESTATUS[n]}	status of stage n of the last pipeline, or
+ *				all of them for [@]
+ *
+ * A word is expanded in one pass into a buffer that is kept between
+ * words, and only the finished result is copied into the line's arena.
+ * Words without a '$' or a backslash are used as they are.  There is no
+ * field splitting: a word stays one word whatever its value holds.
+ */
+
+static struct strbuf exp_buf, exp_spare;
+static Arena *exp_arena;
+
+static int expand_span(const char *s, const char *end);
+
+/**
+ * exp_put - append bytes to the expansion buffer
+ * @s: bytes
+ * @n: number of bytes
+ * Return: 0, or -1 if memory is exhausted
+ */
+
+static int exp_put(const char *s, size_t n)
+{
+	return (strbuf_put(&exp_buf, s, n));
+}
+
+/**
+ * exp_error - report a failed expansion
+ * @s: start of the offending text
+ * @n: its length
+ * @msg: message
+ * Return: -1
+ */
+
+static int exp_error(const char *s, size_t n, const char *msg)
+{
+	_puts_fd(STDERR_FILENO, "hsh: ");
+	_write_buf(STDERR_FILENO, s, n);
+	_puts_fd(STDERR_FILENO, (char *)msg);
+	_puts_fd(STDERR_FILENO, "\n");
+	return (-1);
+}
+
+/**
+ * exp_number - format a number into a caller's buffer
+ * @buf: buffer of at least 24 bytes
+ * @n: number
+ * Return: @buf
+ */
+
+static char *exp_number(char *buf, long n)
+{
+	snprintf(buf, 24, "%ld", n);
+	return (buf);
+}
+
+/**
+ * exp_pipestatus - expand "PIPESTATUS[...]"
+ * @sub: text between the brackets
+ * @n: its length
+ * Return: 0, or -1 on failure
+ */
+
+static int exp_pipestatus(const char *sub, size_t n)
+{
+	char buf[24], *end;
+	long i;
+
+	if (n == 1 && (*sub == '@' || *sub == '*'))
+	{
+		for (i = 0; i < pipestatus_count; i++)
+		{
+			if ((i > 0 && exp_put(" ", 1) != 0) ||
+			    exp_put(buf, strlen(exp_number(buf, pipestatus_get(i)))) != 0)
+				return (-1);
+		}
+		return (0);
+	}
+	i = strtol(sub, &end, 10);
+	if (n == 0 || end != sub + n)
+		return (exp_error(sub, n, ": bad array subscript"));
+	if (i < 0 || i >= pipestatus_count)
+		return (0);
+	return (exp_put(buf, strlen(exp_number(buf, pipestatus_get(i)))));
+}
+
+/**
+ * exp_param - look up a parameter
+ * @name: name, or one of the special parameters
+ * @len: length of @name
+ * @buf: buffer of at least 24 bytes for a special parameter's value
+ * Return: the value, or NULL if the parameter is unset
+ */
+
+static char *exp_param(const char *name, size_t len, char *buf)
+{
+	if (len == 1 && *name == '?')
+		return (exp_number(buf, last_status));
+	if (len == 1 && *name == '$')
+		return (exp_number(buf, getpid()));
+	if (len == 1 && *name == '!')
+		return (last_background_pid > 0 ? exp_number(buf, last_background_pid) : NULL);
+	if (len == 10 && memcmp(name, "PIPESTATUS", 10) == 0)
+		return (pipestatus_count > 0 ? exp_number(buf, pipestatus_get(0)) : NULL);
+	return (var_getn(name, len));
+}
+
+/**
+ * exp_name_len - measure the parameter name at the start of some text
+ * @s: text
+ * Return: length of the name, 1 for a special parameter, 0 for none
+ */
+
+static size_t exp_name_len(const char *s)
+{
+	if (*s == '?' || *s == '$' || *s == '!')
+		return (1);
+	return (var_name_len(s));
+}
+
+/**
+ * exp_close - find the '}' that closes a "${"
+ * @s: first byte after the "${"
+ * @end: end of the text
+ * Return: the '}', or NULL if there is none
+ */
+
+static const char *exp_close(const char *s, const char *end)
+{
+	int depth = 1;
+
+	for (; s < end; s++)
+	{
+		if (*s == '\\' && s + 1 < end)
+			s++;
+		else if (*s == '$' && s + 1 < end && s[1] == '{')
+		{
+			depth++;
+			s++;
+		}
+		else if (*s == '}' && --depth == 0)
+			return (s);
+	}
+	return (NULL);
+}
+
+/**
+ * exp_arith_close - find the "))" that closes a "$(("
+ * @s: first byte after the "$(("
+ * @end: end of the text
+ * Return: the first ')' of the pair, or NULL if there is none
+ */
+
+static const char *exp_arith_close(const char *s, const char *end)
+{
+	int depth = 2;
+
+	for (; s < end; s++)
+	{
+		if (*s == '(')
+			depth++;
+		else if (*s == ')' && --depth == 1)
+			return (s + 1 < end && s[1] == ')' ? s : NULL);
+	}
+	return (NULL);
+}
+
+/**
+ * exp_arith - expand "$((...))"
+ * @s: first byte after the "$(("
+ * @end: the closing "))"
+ * Return: 0, or -1 on failure
+ */
+
+static int exp_arith(const char *s, const char *end)
+{
+	size_t start = exp_buf.len;
+	char buf[24];
+	long n;
+
+	if (expand_span(s, end) != 0 || exp_put("", 1) != 0)
+		return (-1);
+	exp_buf.len = start;
+	if (arith_eval(exp_buf.data + start, strlen(exp_buf.data + start), &n) != 0)
+		return (-1);
+	return (exp_put(buf, strlen(exp_number(buf, n))));
+}
+
+/**
+ * exp_subst_close - find the ')' that closes a "$("
+ * @s: first byte after the "$("
+ * @end: end of the text
+ * Return: the ')', or NULL if there is none
+ */
+
+static const char *exp_subst_close(const char *s, const char *end)
+{
+	int depth = 1;
+
+	for (; s < end; s++)
+	{
+		if (*s == '\\' && s + 1 < end)
+			s++;
+		else if (*s == '"')
+		{
+			for (s++; s < end && *s != '"'; s++)
+			{
+				if (*s == '\\' && s + 1 < end)
+					s++;
+			}
+			if (s == end)
+				return (NULL);
+		}
+		else if (*s == '(')
+			depth++;
+		else if (*s == ')' && --depth == 0)
+			return (s);
+	}
+	return (NULL);
+}
+
+/**
+ * exp_subst - expand "$(...)"
+ * @s: first byte after the "$("
+ * @end: the closing ')'
+ *
+ * The command's own words are expanded while it runs, so the expansion
+ * buffer is set aside for them and the output is appended to it after.
+ * Return: 0, or -1 on failure
+ */
+
+static int exp_subst(const char *s, const char *end)
+{
+	struct strbuf outer = exp_buf;
+	Arena *a = exp_arena;
+	int ret;
+
+	exp_buf = exp_spare;
+	exp_buf.len = 0;
+	exp_spare.data = NULL;
+	exp_spare.cap = 0;
+	ret = command_subst(s, end - s, a, &outer);
+	free(exp_spare.data);
+	exp_spare = exp_buf;
+	exp_buf = outer;
+	exp_arena = a;
+	return (ret);
+}
+
+/**
+ * exp_operator - apply ${name OP word}
+ * @name: parameter name
+ * @len: length of @name
+ * @value: its value, or NULL if unset
+ * @op: the operator, after any ':'
+ * @colon: 1 if the operator had a ':', so that empty counts as unset
+ * @end: end of the word, which starts at op + 1
+ * Return: 0, or -1 on failure
+ */
+
+static int exp_operator(const char *name, size_t len, const char *value,
+			const char *op, int colon, const char *end)
+{
+	int set = value != NULL && (!colon || *value != '\0');
+	size_t start = exp_buf.len;
+
+	switch (*op)
+	{
+	case '-':
+		return (set ? exp_put(value, strlen(value)) : expand_span(op + 1, end));
+	case '+':
+		return (set ? expand_span(op + 1, end) : 0);
+	case '?':
+		if (set)
+			return (exp_put(value, strlen(value)));
+		if (op + 1 == end)
+			return (exp_error(name, len, ": parameter not set"));
+		if (expand_span(op + 1, end) != 0 || exp_put("", 1) != 0)
+			return (-1);
+		_puts_fd(STDERR_FILENO, "hsh: ");
+		_write_buf(STDERR_FILENO, name, len);
+		_puts_fd(STDERR_FILENO, ": ");
+		_puts_fd(STDERR_FILENO, exp_buf.data + start);
+		_puts_fd(STDERR_FILENO, "\n");
+		return (-1);
+	case '=':
+		if (set)
+			return (exp_put(value, strlen(value)));
+		if (var_name_len(name) != len)
+			return (exp_error(name, len, ": cannot assign in this way"));
+		if (expand_span(op + 1, end) != 0 || exp_put("", 1) != 0)
+			return (-1);
+		exp_buf.len--;
+		if (var_setn(name, len, exp_buf.data + start, 0) != 0)
+		{
+			_perror("malloc");
+			return (-1);
+		}
+		return (0);
+	}
+	return (exp_error(name - 2, end - name + 3, ": bad substitution"));
+}
+
+/**
+ * exp_brace - expand the inside of "${...}"
+ * @s: first byte after the "${"
+ * @end: the closing '}'
+ * Return: 0, or -1 on failure
+ */
+
+static int exp_brace(const char *s, const char *end)
+{
+	char buf[24], *value;
+	size_t len;
+	const char *p;
+
+	if (*s == '#' && s + 1 < end)
+	{
+		len = exp_name_len(s + 1);
+		if (len == 0 || s + 1 + len != end)
+			return (exp_error(s - 2, end - s + 3, ": bad substitution"));
+		value = exp_param(s + 1, len, buf);
+		return (exp_put(buf, strlen(exp_number(buf, value ? (long)strlen(value) : 0))));
+	}
+	len = exp_name_len(s);
+	if (len == 0)
+		return (exp_error(s - 2, end - s + 3, ": bad substitution"));
+	p = s + len;
+	if (len == 10 && memcmp(s, "PIPESTATUS", 10) == 0 && p < end && *p == '[')
+	{
+		value = memchr(p, ']', end - p);
+		if (value == NULL || value + 1 != end)
+			return (exp_error(s - 2, end - s + 3, ": bad substitution"));
+		return (exp_pipestatus(p + 1, value - p - 1));
+	}
+	value = exp_param(s, len, buf);
+	if (p == end)
+		return (value ? exp_put(value, strlen(value)) : 0);
+	if (*p == ':' && p + 1 < end)
+		return (exp_operator(s, len, value, p + 1, 1, end));
+	return (exp_operator(s, len, value, p, 0, end));
+}
+
+/**
+ * expand_span - expand a piece of a word into the buffer
+ * @s: start
+ * @end: end
+ * Return: 0, or -1 on failure
+ */
+
+static int expand_span(const char *s, const char *end)
+{
+	char buf[24], *value;
+	const char *p, *close;
+	size_t len;
+
+	while (s < end)
+	{
+		for (p = s; p < end && *p != '$' && *p != '\\'; p++)
+			;
+		if (p > s && exp_put(s, p - s) != 0)
+			return (-1);
+		if (p == end)
+			break;
+		if (*p == '\\')
+		{
+			/* only "\$" and "\\" kept their backslash in the tokenizer */
+			len = p + 1 < end && (p[1] == '$' || p[1] == '\\');
+			if (exp_put(p + len, 1) != 0)
+				return (-1);
+			s = p + 1 + len;
+		}
+		else if (end - p > 2 && p[1] == '(' && p[2] == '(')
+		{
+			close = exp_arith_close(p + 3, end);
+			if (close == NULL)
+				return (exp_error(p, end - p, ": missing \"))\""));
+			if (exp_arith(p + 3, close) != 0)
+				return (-1);
+			s = close + 2;
+		}
+		else if (p + 1 < end && p[1] == '(')
+		{
+			close = exp_subst_close(p + 2, end);
+			if (close == NULL)
+				return (exp_error(p, end - p, ": missing ')'"));
+			if (exp_subst(p + 2, close) != 0)
+				return (-1);
+			s = close + 1;
+		}
+		else if (p + 1 < end && p[1] == '{')
+		{
+			close = exp_close(p + 2, end);
+			if (close == NULL)
+				return (exp_error(p, end - p, ": bad substitution"));
+			if (exp_brace(p + 2, close) != 0)
+				return (-1);
+			s = close + 1;
+		}
+		else if ((len = p + 1 < end ? exp_name_len(p + 1) : 0) > 0)
+		{
+			value = exp_param(p + 1, len, buf);
+			if (value != NULL && exp_put(value, strlen(value)) != 0)
+				return (-1);
+			s = p + 1 + len;
+		}
+		else
+		{
+			if (exp_put("$", 1) != 0)
+				return (-1);
+			s = p + 1;
+		}
+	}
+	return (0);
+}
+
+/**
+ * expand_word - expand the parameters in a word
+ * @a: arena for the result
+ * @word: word
+ * Return: @word itself if there is nothing to expand, otherwise the
+ * expanded copy; NULL on failure, which has been reported
+ */
+
+char *expand_word(Arena *a, char *word)
+{
+	if (strpbrk(word, "$\\") == NULL)
+		return (word);
+	exp_buf.len = 0;
+	exp_arena = a;
+	if (expand_span(word, word + strlen(word)) != 0)
+		return (NULL);
+	return (arena_strndup(a, exp_buf.data ? exp_buf.data : "", exp_buf.len));
+}
+
+/**
+ * expand_command - expand every word of a command
+ * @cmd: command, rewritten in place to use the expanded words
+ * @a: arena for the new argument vector and words
+ * Return: 0, or -1 on failure
+ */
+
+static int expand_command(Command *cmd, Arena *a)
+{
+	char **argv = arena_alloc(a, (cmd->argc + 1) * sizeof(char *));
+	int i;
+
+	for (i = 0; i < cmd->argc; i++)
+	{
+		argv[i] = expand_word(a, cmd->argv[i]);
+		if (argv[i] == NULL)
+			return (-1);
+	}
+	argv[cmd->argc] = NULL;
+	if (cmd->input_file != NULL &&
+	    (cmd->input_file = expand_word(a, cmd->input_file)) == NULL)
+		return (-1);
+	if (cmd->output_file != NULL &&
+	    (cmd->output_file = expand_word(a, cmd->output_file)) == NULL)
+		return (-1);
+	if (argv[0] != cmd->argv[0])
+	{
+		/* "$X" is a command name even when X holds "name=value" */
+		cmd->name = argv[0];
+		if (cmd->builtin == NULL || !(cmd->builtin->flags & BI_SYNTAX))
+			cmd->builtin = builtin_find(argv[0]);
+	}
+	cmd->argv = argv;
+	cmd->argv_cap = cmd->argc + 1;
+	cmd->path = NULL;
+	cmd->expand = 0;
+	return (0);
+}
+
+/**
+ * expand_pipeline - expand the parameters of a pipeline about to run
+ * @pipeline: pipeline as parsed, which is not modified
+ * @a: arena for the expanded copy
+ * Return: @pipeline itself if it has nothing to expand, otherwise an
+ * expanded copy; NULL on failure, which has been reported
+ */
+
+Pipeline *expand_pipeline(Pipeline *pipeline, Arena *a)
+{
+	Pipeline *copy;
+	char *word;
+	int i;
+
+	if (!pipeline->expand)
+		return (pipeline);
+	copy = arena_alloc(a, sizeof(*copy));
+	*copy = *pipeline;
+	copy->commands = arena_alloc(a, pipeline->command_count * sizeof(Command));
+	memcpy(copy->commands, pipeline->commands, pipeline->command_count * sizeof(Command));
+	copy->arena = a;
+	copy->expand = 0;
+	for (i = 0; i < copy->command_count; i++)
+	{
+		if (copy->commands[i].expand && expand_command(&copy->commands[i], a) != 0)
+			return (NULL);
+	}
+	if (copy->pipe_size_word != NULL)
+	{
+		word = expand_word(a, copy->pipe_size_word);
+		if (word == NULL)
+			return (NULL);
+		if (parse_size(word, &copy->pipe_size) != 0)
+		{
+			_puts_fd(STDERR_FILENO, "invalid pipe size '");
+			_puts_fd(STDERR_FILENO, word);
+			_puts_fd(STDERR_FILENO, "'\n");
+			return (NULL);
+		}
+	}
+	return (copy);
+}
@@ -0,0 +1,151 @@
+#include "shell.h"
+
+/*
+ * In-shell replacement for pipeline stages that only copy bytes, such as
+ * "cat f | x" or "x | cat > f".  The data is moved inside the kernel with
+ * copy_file_range() between regular files and splice() when either side
+ * is a pipe, so no copying process is started and nothing passes through
+ * user space; read/write is the fallback for everything else.
+ */
+
+#define COPY_CHUNK (1 << 20)
+
+/**
+ * stage_is_copy - tell whether a command is a plain "cat"
+ * @cmd: command
+ *
+ * Only "cat" with no options and at most one file qualifies; anything
+ * else could change the bytes.
+ * Return: 1 if the stage can be replaced by copy_fd(), 0 otherwise
+ */
+
+int stage_is_copy(Command *cmd)
+{
+	if (cmd->builtin != NULL || _strcmp(cmd->name, "cat") != 0)
+		return (0);
+	if (cmd->argc > 2)
+		return (0);
+	return (cmd->argc == 1 || cmd->argv[1][0] != '-');
+}
+
+/**
+ * copy_rw - copy with read and write through a user-space buffer
+ * @in: source descriptor
+ * @out: destination descriptor
+ * Return: 0 on success, -1 on error
+ */
+
+static int copy_rw(int in, int out)
+{
+	char buf[65536];
+	ssize_t n, w, off;
+
+	while (1)
+	{
+		n = read(in, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return (n < 0 ? -1 : 0);
+		for (off = 0; off < n; off += w)
+		{
+			w = write(out, buf + off, n - off);
+			if (w < 0 && errno == EINTR)
+				w = 0;
+			else if (w < 0)
+				return (-1);
+		}
+	}
+}
+
+/**
+ * copy_fd - copy everything from one descriptor to another
+ * @in: source descriptor
+ * @out: destination descriptor
+ *
+ * The caller must ignore SIGPIPE while this runs if @out may be a pipe
+ * whose reader can go away.
+ * Return: 0 on success, -1 on error with errno set
+ */
+
+int copy_fd(int in, int out)
+{
+	struct stat in_st, out_st;
+	ssize_t n;
+	int moved = 0;
+
+	if (fstat(in, &in_st) != 0 || fstat(out, &out_st) != 0)
+		return (-1);
+
+	if (S_ISFIFO(in_st.st_mode) || S_ISFIFO(out_st.st_mode))
+	{
+		while ((n = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE)) != 0)
+		{
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				return (moved ? -1 : copy_rw(in, out));
+			moved = 1;
+		}
+		return (0);
+	}
+
+	if (S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode))
+	{
+		while ((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0)) != 0)
+		{
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				return (moved ? -1 : copy_rw(in, out));
+			moved = 1;
+		}
+		return (0);
+	}
+
+	return (copy_rw(in, out));
+}
+
+/**
+ * run_copy_stage - perform an elided "cat" stage in the shell
+ * @cmd: the cat command
+ * @in_fd: descriptor to read when cat has no file argument
+ * @out_fd: descriptor to write
+ * Return: exit status the cat would have had
+ */
+
+int run_copy_stage(Command *cmd, int in_fd, int out_fd)
+{
+	void (*old_pipe)(int);
+	int fd = in_fd, ret;
+
+	if (cmd->argc == 2)
+	{
+		fd = open(cmd->argv[1], O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			_puts_fd(STDERR_FILENO, "cat: ");
+			_perror(cmd->argv[1]);
+			return (1);
+		}
+	}
+
+	_flush_all();
+	old_pipe = signal(SIGPIPE, SIG_IGN);
+	ret = copy_fd(fd, out_fd);
+	if (ret != 0 && errno == EPIPE)
+	{
+		/* the reader went away: a real cat would have died of SIGPIPE */
+		ret = 128 + SIGPIPE;
+	}
+	else if (ret != 0)
+	{
+		_perror("cat");
+		ret = 1;
+	}
+	signal(SIGPIPE, old_pipe);
+
+	if (fd != in_fd)
+		close(fd);
+	return (ret);
+}
@@ -0,0 +1,406 @@
+#include "shell.h"
+
+/*
+ * Remembered command locations, as in bash's "hash".  The table is an
+ * open-addressing map from command name to absolute path.  It is thrown
+ * away when PATH changes or when one of the PATH directories is modified.
+ */
+static struct hash_entry *table;
+static size_t table_size;
+static size_t table_count;
+
+static char *hashed_path;
+static struct timespec *dir_mtimes;
+static size_t dir_count;
+static int mtimes_taken;
+static unsigned long path_checked;
+
+/* bumped whenever a remembered path may have been freed */
+unsigned long hash_generation;
+
+/**
+ * hash_string - FNV-1a hash of a string
+ * @s: string
+ * Return: hash value
+ */
+
+static unsigned long hash_string(const char *s)
+{
+	unsigned long h = 2166136261UL;
+
+	while (*s != '\0')
+	{
+		h ^= (unsigned char)*s++;
+		h *= 16777619UL;
+	}
+	return (h);
+}
+
+/**
+ * hash_slot - find the slot holding @name, or the empty slot it would use
+ * @name: command name
+ * Return: pointer to the slot
+ */
+
+static struct hash_entry *hash_slot(const char *name)
+{
+	size_t i = hash_string(name) & (table_size - 1);
+
+	while (table[i].name != NULL && strcmp(table[i].name, name) != 0)
+		i = (i + 1) & (table_size - 1);
+	return (&table[i]);
+}
+
+/**
+ * hash_grow - double the table and re-insert every entry
+ * Return: 0 on success, -1 on allocation failure
+ */
+
+static int hash_grow(void)
+{
+	struct hash_entry *old = table;
+	size_t old_size = table_size, i;
+
+	table_size = table_size ? table_size * 2 : HASH_MIN_SIZE;
+	table = calloc(table_size, sizeof(*table));
+	if (table == NULL)
+	{
+		table = old;
+		table_size = old_size;
+		return (-1);
+	}
+	for (i = 0; i < old_size; i++)
+	{
+		if (old[i].name != NULL)
+			*hash_slot(old[i].name) = old[i];
+	}
+	free(old);
+	return (0);
+}
+
+/**
+ * hash_clear - forget every remembered location
+ */
+
+void hash_clear(void)
+{
+	size_t i;
+
+	for (i = 0; i < table_size; i++)
+	{
+		free(table[i].name);
+		free(table[i].path);
+		table[i].name = NULL;
+		table[i].path = NULL;
+	}
+	table_count = 0;
+	mtimes_taken = 0;
+	hash_generation++;
+}
+
+/**
+ * path_dir_count - count the directories of a PATH value
+ * @path: PATH value
+ * Return: number of directories
+ */
+
+static size_t path_dir_count(const char *path)
+{
+	size_t n = 1;
+
+	for (; *path != '\0'; path++)
+		n += (*path == ':');
+	return (n);
+}
+
+/**
+ * path_dir_mtime - stat the @idx-th directory of PATH
+ * @path: PATH value
+ * @idx: directory index
+ * @ts: receives the modification time, zeroed if the stat fails
+ */
+
+static void path_dir_mtime(const char *path, size_t idx, struct timespec *ts)
+{
+	char dir[PATH_MAX];
+	const char *end;
+	size_t len;
+	struct stat st;
+
+	for (; idx > 0; idx--)
+		path = strchr(path, ':') + 1;
+	end = strchr(path, ':');
+	len = end ? (size_t)(end - path) : strlen(path);
+	if (len == 0)
+		dir[len++] = '.';
+	else if (len >= sizeof(dir))
+		len = sizeof(dir) - 1;
+	else
+		memcpy(dir, path, len);
+	dir[len] = '\0';
+
+	ts->tv_sec = 0;
+	ts->tv_nsec = 0;
+	if (stat(dir, &st) == 0)
+		*ts = st.st_mtim;
+}
+
+/**
+ * hash_validate - drop the table if PATH or a PATH directory changed
+ *
+ * Called once per pipeline, so repeated commands cost one stat() per PATH
+ * directory instead of an access() per directory per command.  Nothing is
+ * statted while the table is empty, and the directory times are first
+ * recorded by the pipeline after the one that filled the table, so a
+ * shell that runs a single command never pays for them.  PATH itself is
+ * only compared again after some variable has changed.
+ */
+
+void hash_validate(void)
+{
+	char *path = var_get("PATH");
+	struct timespec ts;
+	size_t i;
+	int stale = 0;
+
+	if (path == NULL)
+		path = "";
+
+	if (hashed_path == NULL ||
+	    (path_checked != var_generation && strcmp(hashed_path, path) != 0))
+	{
+		free(hashed_path);
+		free(dir_mtimes);
+		hashed_path = _strdup(path);
+		dir_count = path_dir_count(path);
+		dir_mtimes = malloc(dir_count * sizeof(*dir_mtimes));
+		if (hashed_path == NULL || dir_mtimes == NULL)
+		{
+			free(hashed_path);
+			free(dir_mtimes);
+			hashed_path = NULL;
+			dir_mtimes = NULL;
+			dir_count = 0;
+		}
+		path_checked = var_generation;
+		hash_clear();
+		return;
+	}
+	path_checked = var_generation;
+
+	if (table_count == 0)
+	{
+		mtimes_taken = 0;
+		return;
+	}
+
+	for (i = 0; i < dir_count; i++)
+	{
+		path_dir_mtime(path, i, &ts);
+		if (mtimes_taken && (ts.tv_sec != dir_mtimes[i].tv_sec ||
+				     ts.tv_nsec != dir_mtimes[i].tv_nsec))
+			stale = 1;
+		dir_mtimes[i] = ts;
+	}
+	mtimes_taken = 1;
+	if (stale)
+		hash_clear();
+}
+
+/**
+ * search_path - walk PATH for an executable
+ * @cmd: command name
+ * Return: malloc'd absolute path, or NULL
+ */
+
+static char *search_path(char *cmd)
+{
+	char *path = var_get("PATH");
+	char *full_path;
+	const char *dir, *end;
+	size_t dir_len, cmd_len;
+
+	if (path == NULL)
+		return (NULL);
+
+	cmd_len = _strlen(cmd);
+	full_path = malloc(_strlen(path) + cmd_len + 3);
+	if (full_path == NULL)
+		return (NULL);
+
+	for (dir = path; dir != NULL; dir = end ? end + 1 : NULL)
+	{
+		end = strchr(dir, ':');
+		dir_len = end ? (size_t)(end - dir) : strlen(dir);
+		if (dir_len == 0)
+			full_path[dir_len++] = '.';
+		else
+			memcpy(full_path, dir, dir_len);
+		full_path[dir_len] = '/';
+		memcpy(full_path + dir_len + 1, cmd, cmd_len + 1);
+
+		if (access(full_path, X_OK) == 0)
+			return (full_path);
+	}
+	free(full_path);
+	return (NULL);
+}
+
+/**
+ * hash_insert - remember a location
+ * @name: command name
+ * @path: malloc'd absolute path, owned by the table afterwards
+ * Return: the entry, or NULL on allocation failure
+ */
+
+static struct hash_entry *hash_insert(char *name, char *path)
+{
+	struct hash_entry *e;
+
+	if ((table_count + 1) * 4 > table_size * 3 && hash_grow() != 0)
+		return (NULL);
+
+	e = hash_slot(name);
+	if (e->name == NULL)
+	{
+		e->name = _strdup(name);
+		if (e->name == NULL)
+			return (NULL);
+		table_count++;
+	}
+	else
+	{
+		free(e->path);
+		hash_generation++;
+	}
+	e->path = path;
+	e->hits = 0;
+	return (e);
+}
+
+/**
+ * hash_find - look a command up, searching PATH on a miss
+ * @cmd: command name
+ * Return: the entry, or NULL if @cmd is not in PATH
+ */
+
+static struct hash_entry *hash_find(char *cmd)
+{
+	struct hash_entry *e;
+	char *full_path;
+
+	if (table_size > 0)
+	{
+		e = hash_slot(cmd);
+		if (e->name != NULL)
+			return (e);
+	}
+
+	full_path = search_path(cmd);
+	if (full_path == NULL)
+		return (NULL);
+	e = hash_insert(cmd, full_path);
+	if (e == NULL)
+		free(full_path);
+	return (e);
+}
+
+/**
+ * find_command_in_path - resolve a command name to an executable
+ * @cmd: command name
+ * Return: path owned by the hash table, or NULL if @cmd contains a '/'
+ * or is not found
+ */
+
+char *find_command_in_path(char *cmd)
+{
+	struct hash_entry *e;
+
+	if (strchr(cmd, '/') != NULL)
+		return (NULL);
+
+	e = hash_find(cmd);
+	if (e == NULL)
+		return (NULL);
+	e->hits++;
+	return (e->path);
+}
+
+/**
+ * hash_builtin - the "hash" builtin
+ * @args: argument vector, args[0] is the command itself
+ * Return: 0 on success, 1 if a name was not found
+ */
+
+int hash_builtin(char **args)
+{
+	char buf[32];
+	size_t i;
+	int status = 0, list = 0, reset = 0, names = 0;
+
+	for (args++; *args != NULL && (*args)[0] == '-'; args++)
+	{
+		if (_strcmp(*args, "-r") == 0)
+		{
+			hash_clear();
+			reset = 1;
+		}
+		else if (_strcmp(*args, "-l") == 0)
+		{
+			list = 1;
+		}
+		else
+		{
+			_puts_fd(STDERR_FILENO, "hash: usage: hash [-lr] [name ...]\n");
+			return (2);
+		}
+	}
+
+	if (*args == NULL && reset && !list)
+		return (0);
+
+	for (; *args != NULL; args++)
+	{
+		names = 1;
+		if (hash_find(*args) == NULL)
+		{
+			_puts_fd(STDERR_FILENO, "hash: ");
+			_puts_fd(STDERR_FILENO, *args);
+			_puts_fd(STDERR_FILENO, ": not found\n");
+			status = 1;
+		}
+	}
+
+	if (names)
+		return (status);
+
+	if (table_count == 0)
+	{
+		if (!list)
+			_puts("hash: hash table empty\n");
+		return (0);
+	}
+
+	if (!list)
+		_puts("hits\tcommand\n");
+	for (i = 0; i < table_size; i++)
+	{
+		if (table[i].name == NULL)
+			continue;
+		if (list)
+		{
+			_puts("builtin hash -p ");
+			_puts(table[i].path);
+			_puts(" ");
+			_puts(table[i].name);
+		}
+		else
+		{
+			snprintf(buf, sizeof(buf), "%4d\t", table[i].hits);
+			_puts(buf);
+			_puts(table[i].path);
+		}
+		_puts("\n");
+	}
+	return (0);
+}
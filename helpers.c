@@ -1,128 +1,388 @@
 #include "shell.h"
 
-extern char **environ;
-
-char *find_command_in_path(char *cmd)
+/*
+ * Closes the descriptors open_redirections() opened.
+ */
+static void close_redirections(int *redir_fds, int n)
 {
-    char *path = getenv("PATH");
-    char *path_copy = _strdup(path);
-    char *dir = strtok(path_copy, ":");
-
-    if (!path)
-        return NULL;
+    int i;
 
-    while (dir != NULL)
+    for (i = 0; i < n; i++)
     {
-        size_t full_path_len = _strlen(dir) + _strlen(cmd) + 2;
-        char *full_path = malloc(full_path_len);
-
-        if (!full_path)
+        if (redir_fds[i] >= 0)
         {
-            free(path_copy);
-            return NULL;
+            close(redir_fds[i]);
         }
+    }
+}
 
-        _strcpy(full_path, dir);
-        _strcat(full_path, "/");
-        _strcat(full_path, cmd);
+/*
+ * Opens each stage's redirection targets, in the order the stages are
+ * written: redir_fds[2 * i] is stage i's input and redir_fds[2 * i + 1]
+ * its output, or -1 where the stage keeps its pipe or the shell's own
+ * descriptor.  The first stage of a background job without an input file
+ * reads /dev/null, as there is no job control to hand it the terminal.
+ */
+static int open_redirections(Pipeline *pipeline, int *redir_fds)
+{
+    int i, mode;
+    char *path = NULL;
 
-        if (access(full_path, X_OK) == 0)
+    for (i = 0; i < 2 * pipeline->command_count; i++)
+    {
+        redir_fds[i] = -1;
+    }
+    for (i = 0; i < pipeline->command_count; i++)
+    {
+        Command *cmd = &pipeline->commands[i];
+
+        path = cmd->input_file;
+        if (path == NULL && i == 0 && pipeline->background)
         {
-            free(path_copy);
-            return full_path;
+            path = "/dev/null";
         }
+        if (path != NULL)
+        {
+            redir_fds[2 * i] = open(path, O_RDONLY | O_CLOEXEC);
+            if (redir_fds[2 * i] < 0)
+            {
+                break;
+            }
+        }
+        path = cmd->output_file;
+        if (path != NULL)
+        {
+            mode = O_WRONLY | O_CREAT | O_CLOEXEC | (cmd->append ? O_APPEND : O_TRUNC);
+            redir_fds[2 * i + 1] = open(path, mode, 0666);
+            if (redir_fds[2 * i + 1] < 0)
+            {
+                break;
+            }
+        }
+    }
+    if (i < pipeline->command_count)
+    {
+        _perror(path);
+        close_redirections(redir_fds, 2 * pipeline->command_count);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Resizes a pipe's buffer.  The kernel rounds the size up to a power of
+ * two pages and caps it for unprivileged users at
+ * /proc/sys/fs/pipe-max-size; what it granted is what "set -o" reports.
+ */
+static void set_pipe_size(int fd, long size)
+{
+    int granted = fcntl(fd, F_SETPIPE_SZ, size > INT_MAX ? INT_MAX : (int)size);
+
+    if (granted < 0)
+    {
+        _perror("pipesize");
+        granted = fcntl(fd, F_GETPIPE_SZ);
+    }
+    if (granted > 0)
+    {
+        pipe_size_effective = granted;
+    }
+}
+
+/*
+ * Picks at most one "cat" stage that the shell can do itself with
+ * copy_fd(): a first stage reading a file, or a last stage writing into a
+ * redirected file.  Returns its index, or -1.
+ */
+static int pick_copy_stage(Pipeline *pipeline)
+{
+    int last = pipeline->command_count - 1;
+    Command *first = &pipeline->commands[0];
+    Command *tail = &pipeline->commands[last];
+    bool has_source = first->argc == 2 || first->input_file != NULL;
+
+    if (stage_is_copy(first) && has_source &&
+        (last > 0 || first->output_file != NULL))
+    {
+        return 0;
+    }
+    if (last > 0 && stage_is_copy(tail) && tail->argc == 1 && tail->output_file != NULL)
+    {
+        return last;
+    }
+    return -1;
+}
 
-        free(full_path);
-        dir = strtok(NULL, ":");
+/*
+ * Runs a builtin in the shell process with its stdin/stdout temporarily
+ * pointed at the given descriptors.
+ */
+static int run_builtin(const struct builtin *bi, char **args, int in_fd, int out_fd)
+{
+    int saved_in = -1, saved_out = -1;
+    int status;
+
+    _flush_all();
+    if (in_fd != STDIN_FILENO)
+    {
+        saved_in = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(in_fd, STDIN_FILENO);
+    }
+    if (out_fd != STDOUT_FILENO)
+    {
+        saved_out = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+        dup2(out_fd, STDOUT_FILENO);
     }
 
-    free(path_copy);
-    return NULL;
+    status = bi->handler(args);
+
+    _flush_all();
+    if (saved_in >= 0)
+    {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    if (saved_out >= 0)
+    {
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+    return status;
 }
 
-void execute_pipeline(Pipeline *pipeline)
+/*
+ * With EXEC_TAIL, a pipeline consisting of a single external command
+ * replaces the shell instead of being forked and waited for.  Every stage
+ * gets a struct child, whether it ran as a process or inside the shell,
+ * so $? and PIPESTATUS come from the stages themselves.
+ *
+ * Parameters are expanded first, into a copy of the pipeline when it has
+ * any; the parsed pipeline may be cached and run again.
+ *
+ * A background pipeline becomes a job in its own process group.  All of
+ * its stages are processes, and the shell returns as soon as they are
+ * started; the job's children stay registered with the reaper.
+ */
+void execute_pipeline(Pipeline *pipeline, Arena *scratch, int flags)
 {
     int num_pipes = pipeline->command_count - 1;
     int *pipe_fds;
-    int i, j;
+    int *redir_fds;
+    int i, status, in_shell;
+    int copy_stage, copy_in = -1, copy_out = -1;
+    long pipe_size;
+    pid_t pid, pgid = pipeline->background ? 0 : -1;
+    struct child *children;
+    struct job *job = NULL;
+    struct rusage self;
+    long t0, t_start = pipeline->timed && !pipeline->background ? clock_us() : 0;
 
-    pipe_fds = (int *)malloc(2 * num_pipes * sizeof(int));
-    if (pipe_fds == NULL)
+    pipeline = expand_pipeline(pipeline, scratch);
+    if (pipeline == NULL)
     {
-        perror("malloc");
+        last_status = 1;
+        return;
+    }
+    hash_validate();
+    redir_fds = arena_alloc(scratch, 2 * pipeline->command_count * sizeof(int));
+    if (redir_fds == NULL)
+    {
+        _perror("malloc");
         exit(EXIT_FAILURE);
     }
+    if (open_redirections(pipeline, redir_fds) != 0)
+    {
+        last_status = 1;
+        return;
+    }
 
+    pipe_fds = arena_alloc(scratch, (2 * num_pipes + 1) * sizeof(int));
+    if (pipeline->background)
+    {
+        job = job_new(pipeline);
+        children = job != NULL ? job->children : NULL;
+    }
+    else
+    {
+        children = arena_alloc(scratch, pipeline->command_count * sizeof(*children));
+    }
+    if (pipe_fds == NULL || children == NULL)
+    {
+        _perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    pipe_size = pipeline->pipe_size >= 0 ? pipeline->pipe_size : shell_options[OPT_PIPESIZE].value;
     for (i = 0; i < num_pipes; i++)
     {
-        if (pipe(pipe_fds + i * 2) < 0)
+        if (pipe2(pipe_fds + i * 2, O_CLOEXEC) < 0)
         {
-            perror("pipe");
+            _perror("pipe");
             exit(EXIT_FAILURE);
         }
+        if (pipe_size > 0)
+        {
+            set_pipe_size(pipe_fds[i * 2], pipe_size);
+        }
     }
 
+    copy_stage = job == NULL ? pick_copy_stage(pipeline) : -1;
+
     for (i = 0; i < pipeline->command_count; i++)
     {
         Command *cmd = &pipeline->commands[i];
-        pid_t pid = fork();
+        int in_fd = redir_fds[2 * i] >= 0 ? redir_fds[2 * i] :
+            i > 0 ? pipe_fds[(i - 1) * 2] : STDIN_FILENO;
+        int out_fd = redir_fds[2 * i + 1] >= 0 ? redir_fds[2 * i + 1] :
+            i < num_pipes ? pipe_fds[i * 2 + 1] : STDOUT_FILENO;
+        char **args = cmd->argv;
+        char *path;
+        long t_stage = t_start ? clock_us() : trace_begin();
 
-        int num_args = CL_length(cmd->args);
-        char **args = malloc((num_args + 2) * sizeof(char *));
-        args[0] = find_command_in_path(cmd->name);
-        if (!args[0])
+        pid = -1;
+        status = 0;
+        in_shell = 0;
+        if (i == copy_stage)
         {
-            args[0] = cmd->name;
+            copy_in = in_fd;
+            copy_out = out_fd;
         }
-        for (j = 0; j < num_args; j++)
+        else if (cmd->builtin != NULL && job == NULL &&
+            (pipeline->command_count == 1 || !(cmd->builtin->flags & BI_SUBSHELL)))
         {
-            Token arg = CL_nth(cmd->args, j);
-            args[j + 1] = arg.value;
+            if (t_start)
+            {
+                time_self_begin(&self);
+            }
+            status = run_builtin(cmd->builtin, args, in_fd, out_fd);
+            in_shell = 1;
         }
-        args[num_args + 1] = NULL;
-
-        if (is_builtin_command(cmd->name))
+        else if (cmd->builtin != NULL)
         {
-            handle_builtin_command(cmd->name, args);
-            if (args[0] != cmd->name)
-                free(args[0]);
-            free(args);
-            continue;
+            pid = spawn_builtin(cmd->builtin, args, in_fd, out_fd, pgid);
+            trace_end("spawn", cmd->name, t_stage);
         }
-
-        if (pid < 0)
+        else
         {
-            perror("fork");
-            exit(EXIT_FAILURE);
+            if (cmd->path == NULL || cmd->path_gen != hash_generation)
+            {
+                t0 = trace_begin();
+                cmd->path = find_command_in_path(cmd->name);
+                cmd->path_gen = hash_generation;
+                trace_end("lookup", cmd->name, t0);
+            }
+            path = cmd->path ? cmd->path : cmd->name;
+            /* nothing may be left to report once the shell is gone */
+            if ((flags & EXEC_TAIL) && pipeline->command_count == 1 && job == NULL &&
+                !pipeline->timed && !shell_options[OPT_TRACE_TIMING].value)
+            {
+                exec_command(path, args, in_fd, out_fd);
+            }
+            t0 = trace_begin();
+            pid = spawn_command(path, args, in_fd, out_fd, pgid);
+            trace_end("spawn", cmd->name, t0);
+            if (pid < 0)
+            {
+                status = 127;
+            }
         }
 
-        if (pid == 0)
+        child_init(&children[i], pid, status);
+        if (i != copy_stage)
         {
-
-            for (j = 0; j < 2 * num_pipes; j++)
+            children[i].started = t_stage;
+            children[i].ended = pid > 0 || t_stage == 0 ? 0 : clock_us();
+            if (in_shell && t_start)
             {
-                close(pipe_fds[j]);
+                time_self_end(&children[i], &self);
             }
+        }
+        reap_register(&children[i]);
+        if (pgid == 0 && pid > 0)
+        {
+            /* the first stage started leads the job's process group */
+            pgid = pid;
+        }
+    }
 
-            if (execve(args[0], args, environ) == -1)
+    if (copy_stage >= 0)
+    {
+        /* drop every pipe end but ours, so the readers can see EOF */
+        for (i = 0; i < 2 * num_pipes; i++)
+        {
+            if (pipe_fds[i] != copy_in && pipe_fds[i] != copy_out)
             {
-                perror("execve");
-                exit(EXIT_FAILURE);
+                close(pipe_fds[i]);
+                pipe_fds[i] = -1;
             }
         }
-        if (args[0] != cmd->name)
-            free(args[0]);
-        free(args);
+        children[copy_stage].started = t_start ? clock_us() : trace_begin();
+        if (t_start)
+        {
+            time_self_begin(&self);
+        }
+        children[copy_stage].status = run_copy_stage(&pipeline->commands[copy_stage], copy_in, copy_out);
+        children[copy_stage].ended = children[copy_stage].started ? clock_us() : 0;
+        if (t_start)
+        {
+            time_self_end(&children[copy_stage], &self);
+        }
     }
 
     for (i = 0; i < 2 * num_pipes; i++)
     {
-        close(pipe_fds[i]);
+        if (pipe_fds[i] >= 0)
+        {
+            close(pipe_fds[i]);
+        }
     }
+    close_redirections(redir_fds, 2 * pipeline->command_count);
 
-    for (i = 0; i < pipeline->command_count; i++)
+    if (job != NULL)
+    {
+        job->pgid = pgid;
+        job_launched(job);
+        last_status = 0;
+        return;
+    }
+    t0 = trace_begin();
+    reap_wait(children, pipeline->command_count);
+    trace_end("wait", NULL, t0);
+    for (i = 0; t0 != 0 && i < pipeline->command_count; i++)
+    {
+        trace_child(&children[i], pipeline->commands[i].name);
+    }
+    if (t_start)
+    {
+        time_report(pipeline, children, clock_us() - t_start);
+    }
+    last_status = pipeline_status(children, pipeline->command_count);
+}
+
+/*
+ * Runs the pipelines of a list in order.  A pipeline after '&&' only runs
+ * if the status so far is zero, one after '||' only if it is not; a
+ * skipped pipeline leaves the status alone, so "a && b || c" runs c when
+ * either a or b fails.  EXEC_TAIL only applies to the last pipeline.
+ */
+void execute_list(CommandList *list, Arena *scratch, int flags)
+{
+    int i;
+
+    for (i = 0; i < list->count; i++)
     {
-        wait(NULL);
+        ListItem *item = &list->items[i];
+
+        if ((item->op == LIST_AND && last_status != 0) ||
+            (item->op == LIST_OR && last_status == 0))
+        {
+            continue;
+        }
+        if (item->pipeline->command_count == 0)
+        {
+            continue;
+        }
+        execute_pipeline(item->pipeline, scratch, i == list->count - 1 ? flags : 0);
     }
 }
 
@@ -130,7 +390,10 @@ void execute_command(char *cmd, char **args)
 {
     int i;
     char *full_path = find_command_in_path(cmd);
-    pid_t pid = fork();
+    pid_t pid;
+
+    _flush_all();
+    pid = fork();
     if (!full_path)
     {
         full_path = cmd;
@@ -138,7 +401,7 @@ void execute_command(char *cmd, char **args)
 
     if (pid == -1)
     {
-        perror("fork");
+        _perror("fork");
     }
     else if (pid == 0)
     {
@@ -150,9 +413,9 @@ void execute_command(char *cmd, char **args)
             _puts("\n");
         }
 
-        if (execve(full_path, args, environ) == -1)
+        if (execve(full_path, args, var_environ()) == -1)
         {
-            perror("execve");
+            _perror("execve");
             exit(EXIT_FAILURE);
         }
     }
@@ -161,64 +424,4 @@ void execute_command(char *cmd, char **args)
         int status;
         waitpid(pid, &status, 0);
     }
-    if (full_path != cmd)
-    {
-        free(full_path);
-    }
 }
-
-int is_builtin_command(char *cmd)
-{
-    int i;
-    char *builtins[] = {"exit", "cd", "quit", "author", "pwd", NULL};
-
-    for (i = 0; builtins[i] != NULL; i++)
-    {
-        if (_strcmp(cmd, builtins[i]) == 0)
-        {
-            return 1;
-        }
-    }
-    return 0;
-}
-
-void handle_builtin_command(char *cmd, char **args)
-{
-    if (_strcmp(cmd, "exit") == 0 || _strcmp(cmd, "quit") == 0)
-    {
-        exit(0);
-    }
-    else if (_strcmp(cmd, "author") == 0)
-    {
-        char *author = "Innocent Ingabire";
-        _puts(author);
-        fflush(stdout);
-    }
-    else if (_strcmp(cmd, "cd") == 0)
-    {
-        const char *dir = getenv("HOME");
-        if (args[1] && _strcmp(args[1], "~") != 0)
-        {
-            dir = args[1];
-        }
-        if (chdir(dir) != 0)
-        {
-            perror("chdir");
-        }
-    }
-    else if (_strcmp(cmd, "pwd") == 0)
-    {
-        char cwd[1024];
-        if (getcwd(cwd, sizeof(cwd)) != NULL)
-        {
-            _puts(cwd);
-            fflush(stdout);
-        }
-        else
-        {
-            perror("getcwd");
-        }
-    }
-}
-
-
@@ -0,0 +1,400 @@
+#include "shell.h"
+
+/*
+ * Background jobs.  A pipeline ending in '&' gets a job: one malloc'd
+ * block holding the job, its struct child array and a copy of its text,
+ * since all three outlive the line arena.  The children stay registered
+ * with the reaper, so a job's processes are collected whenever the shell
+ * polls for anything, and "wait" only has to look at the flags.
+ *
+ * Job numbers are table slots plus one; a slot is reused once the job in
+ * it has been reported.
+ */
+
+static struct job **job_table;
+static int job_cap;
+
+/* set in a subshell that only lists a snapshot of the parent's jobs */
+static int jobs_frozen;
+
+/* last process of the most recent background job, for "$!" */
+pid_t last_background_pid;
+
+/**
+ * text_append - copy a string into the job text, or only measure it
+ * @dst: destination, or NULL to measure
+ * @len: bytes already in the text
+ * @s: string to append
+ * Return: the new length
+ */
+
+static size_t text_append(char *dst, size_t len, const char *s)
+{
+	size_t n = strlen(s);
+
+	if (dst != NULL)
+		memcpy(dst + len, s, n);
+	return (len + n);
+}
+
+/**
+ * job_text - rebuild a pipeline's command text for "jobs"
+ * @pipeline: pipeline
+ * @dst: destination, or NULL to measure
+ *
+ * The input line was tokenized in place, so the text is put together
+ * again from the words.
+ * Return: length of the text, without the terminator
+ */
+
+static size_t job_text(Pipeline *pipeline, char *dst)
+{
+	Command *cmd;
+	size_t len = 0;
+	int i, j;
+
+	for (i = 0; i < pipeline->command_count; i++)
+	{
+		cmd = &pipeline->commands[i];
+		if (i > 0)
+			len = text_append(dst, len, " | ");
+		for (j = 0; j < cmd->argc; j++)
+		{
+			if (j > 0)
+				len = text_append(dst, len, " ");
+			len = text_append(dst, len, cmd->argv[j]);
+		}
+		if (cmd->input_file != NULL)
+		{
+			len = text_append(dst, len, " < ");
+			len = text_append(dst, len, cmd->input_file);
+		}
+		if (cmd->output_file != NULL)
+		{
+			len = text_append(dst, len, cmd->append ? " >> " : " > ");
+			len = text_append(dst, len, cmd->output_file);
+		}
+	}
+	if (dst != NULL)
+		dst[len] = '\0';
+	return (len);
+}
+
+/**
+ * job_new - allocate a job for a background pipeline
+ * @pipeline: pipeline about to be started
+ *
+ * The caller fills in the children and the process group.
+ * Return: the job, or NULL if memory is exhausted
+ */
+
+struct job *job_new(Pipeline *pipeline)
+{
+	struct job *job, **tmp;
+	size_t size;
+	int slot, cap;
+
+	for (slot = 0; slot < job_cap && job_table[slot] != NULL; slot++)
+		;
+	if (slot == job_cap)
+	{
+		cap = job_cap ? job_cap * 2 : 8;
+		tmp = realloc(job_table, cap * sizeof(*tmp));
+		if (tmp == NULL)
+			return (NULL);
+		_memset((char *)(tmp + job_cap), 0, (cap - job_cap) * sizeof(*tmp));
+		job_table = tmp;
+		job_cap = cap;
+	}
+
+	size = sizeof(*job) + pipeline->command_count * sizeof(struct child);
+	job = malloc(size + job_text(pipeline, NULL) + 1);
+	if (job == NULL)
+		return (NULL);
+	job->id = slot + 1;
+	job->pgid = -1;
+	job->nchildren = pipeline->command_count;
+	job->children = (struct child *)(job + 1);
+	job->text = (char *)job + size;
+	job_text(pipeline, job->text);
+	job_table[slot] = job;
+	return (job);
+}
+
+/**
+ * job_launched - announce a job that has been started
+ * @job: job
+ */
+
+void job_launched(struct job *job)
+{
+	char buf[48];
+
+	last_background_pid = job->children[job->nchildren - 1].pid;
+	if (!interactive)
+		return;
+	snprintf(buf, sizeof(buf), "[%d] %d\n", job->id,
+		 (int)job->children[job->nchildren - 1].pid);
+	_puts_fd(STDERR_FILENO, buf);
+}
+
+/**
+ * job_done - tell whether every process of a job has been reaped
+ * @job: job
+ * Return: 1 if the job is finished, 0 otherwise
+ */
+
+static int job_done(struct job *job)
+{
+	int i;
+
+	for (i = 0; i < job->nchildren; i++)
+	{
+		if (!job->children[i].done)
+			return (0);
+	}
+	return (1);
+}
+
+/**
+ * job_pollable - tell whether a job can be waited for through the reaper
+ * @job: job
+ * Return: 1 if every running process has a pidfd, 0 otherwise
+ */
+
+static int job_pollable(struct job *job)
+{
+	int i;
+
+	for (i = 0; i < job->nchildren; i++)
+	{
+		if (!job->children[i].done && job->children[i].pidfd < 0)
+			return (0);
+	}
+	return (1);
+}
+
+/**
+ * job_print - print one line of "jobs" output
+ * @job: job
+ */
+
+static void job_print(struct job *job)
+{
+	char state[32], buf[64];
+	int status;
+
+	if (!job_done(job))
+	{
+		snprintf(state, sizeof(state), "Running");
+	}
+	else
+	{
+		status = children_status(job->children, job->nchildren);
+		if (status == 0)
+			snprintf(state, sizeof(state), "Done");
+		else
+			snprintf(state, sizeof(state), "Exit %d", status);
+	}
+	snprintf(buf, sizeof(buf), "[%d]  %-24s", job->id, state);
+	_puts(buf);
+	_puts(job->text);
+	_puts("\n");
+}
+
+/**
+ * job_remove - drop a finished job from the table
+ * @job: job
+ * Return: the job's exit status
+ */
+
+static int job_remove(struct job *job)
+{
+	int i, status = children_status(job->children, job->nchildren);
+
+	for (i = 0; i < job->nchildren; i++)
+		trace_child(&job->children[i], job->text);
+	job_table[job->id - 1] = NULL;
+	free(job);
+	return (status);
+}
+
+/**
+ * jobs_notify - report background jobs that have finished
+ *
+ * Called before each prompt.  Finished jobs are dropped once reported.
+ */
+
+void jobs_notify(void)
+{
+	int i;
+
+	reap_poll(0);
+	for (i = 0; i < job_cap; i++)
+	{
+		if (job_table[i] != NULL && job_done(job_table[i]))
+		{
+			job_print(job_table[i]);
+			job_remove(job_table[i]);
+		}
+	}
+}
+
+/**
+ * jobs_builtin - the "jobs" builtin
+ * @args: argument vector
+ * Return: 0
+ */
+
+int jobs_builtin(char **args __attribute__((unused)))
+{
+	int i;
+
+	reap_poll(0);
+	for (i = 0; i < job_cap; i++)
+	{
+		if (job_table[i] == NULL)
+			continue;
+		job_print(job_table[i]);
+		if (job_done(job_table[i]) && !jobs_frozen)
+			job_remove(job_table[i]);
+	}
+	return (0);
+}
+
+/**
+ * jobs_clear - forget every job, in a forked subshell
+ *
+ * The jobs are the parent's children, which a subshell cannot wait for.
+ */
+
+void jobs_clear(void)
+{
+	int i;
+
+	for (i = 0; i < job_cap; i++)
+	{
+		free(job_table[i]);
+		job_table[i] = NULL;
+	}
+}
+
+/**
+ * jobs_snapshot - keep the job table in a forked subshell, for "jobs"
+ *
+ * The subshell cannot wait for the parent's children, so the table shows
+ * the states known at the fork.  Finished jobs are left for the parent to
+ * report.
+ */
+
+void jobs_snapshot(void)
+{
+	jobs_frozen = 1;
+}
+
+/**
+ * job_find - look a job up by "%n" or by the pid of one of its processes
+ * @spec: job specification
+ * Return: the job, or NULL
+ */
+
+static struct job *job_find(const char *spec)
+{
+	char *end;
+	long n;
+	int i, j;
+
+	n = strtol(spec + (*spec == '%'), &end, 10);
+	if (end == spec + (*spec == '%') || *end != '\0' || n <= 0)
+		return (NULL);
+	if (*spec == '%')
+		return (n <= job_cap ? job_table[n - 1] : NULL);
+	for (i = 0; i < job_cap; i++)
+	{
+		for (j = 0; job_table[i] != NULL && j < job_table[i]->nchildren; j++)
+		{
+			if (job_table[i]->children[j].pid == n)
+				return (job_table[i]);
+		}
+	}
+	return (NULL);
+}
+
+/**
+ * wait_next - wait for whichever job finishes first
+ * Return: its exit status, or 127 if there are no jobs
+ */
+
+static int wait_next(void)
+{
+	int i, any;
+
+	while (1)
+	{
+		any = 0;
+		for (i = 0; i < job_cap; i++)
+		{
+			if (job_table[i] == NULL)
+				continue;
+			if (job_done(job_table[i]))
+				return (job_remove(job_table[i]));
+			if (!job_pollable(job_table[i]))
+			{
+				reap_wait(job_table[i]->children, job_table[i]->nchildren);
+				return (job_remove(job_table[i]));
+			}
+			any = 1;
+		}
+		if (!any)
+			return (127);
+		reap_poll(-1);
+	}
+}
+
+/**
+ * wait_builtin - the "wait" builtin
+ * @args: argument vector: nothing, "-n", or job specifications
+ *
+ * Without arguments every job is waited for and the status is 0;
+ * otherwise the status is that of the last job named, or 127 if it does
+ * not exist.
+ * Return: exit status
+ */
+
+int wait_builtin(char **args)
+{
+	struct job *job;
+	int i, status = 0;
+
+	_flush_all();
+	if (args[1] != NULL && _strcmp(args[1], "-n") == 0)
+		return (wait_next());
+
+	if (args[1] == NULL)
+	{
+		for (i = 0; i < job_cap; i++)
+		{
+			if (job_table[i] == NULL)
+				continue;
+			reap_wait(job_table[i]->children, job_table[i]->nchildren);
+			job_remove(job_table[i]);
+		}
+		return (0);
+	}
+
+	for (args++; *args != NULL; args++)
+	{
+		job = job_find(*args);
+		if (job == NULL)
+		{
+			_puts_fd(STDERR_FILENO, "wait: ");
+			_puts_fd(STDERR_FILENO, *args);
+			_puts_fd(STDERR_FILENO, ": no such job\n");
+			status = 127;
+			continue;
+		}
+		reap_wait(job->children, job->nchildren);
+		status = job_remove(job);
+	}
+	return (status);
+}
@@ -0,0 +1,362 @@
+#include "shell.h"
+
+/*
+ * Parsed-line cache.  A line that parsed cleanly is stored, keyed by its
+ * raw text, as a flattened CommandList: one malloc'd block holding the
+ * list, its pipelines, commands, argv arrays and strings.  A later line
+ * with the same text runs that block directly and skips the tokenizer and
+ * the parser.  Entries are kept in LRU order and the capacity is
+ * "set -o linecache=N" (0 turns the cache off).
+ *
+ * Cached commands also remember their resolved path; it is trusted only
+ * while hash_generation is unchanged.
+ */
+
+struct line_entry {
+	unsigned long hash;
+	size_t len;
+	char *line;
+	CommandList *list;
+	struct line_entry *hnext;
+	struct line_entry *prev;
+	struct line_entry *next;
+};
+
+static struct line_entry **buckets;
+static size_t nbuckets;
+static size_t nentries;
+static struct line_entry *lru_head;
+static struct line_entry *lru_tail;
+static unsigned long cache_hits, cache_misses;
+static int flush_pending;
+
+/**
+ * line_hash - FNV-1a hash of a line
+ * @s: line
+ * @len: length of @s
+ * Return: hash value
+ */
+
+static unsigned long line_hash(const char *s, size_t len)
+{
+	unsigned long h = 2166136261UL;
+
+	while (len-- > 0)
+	{
+		h ^= (unsigned char)*s++;
+		h *= 16777619UL;
+	}
+	return (h);
+}
+
+#define FLAT_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+/**
+ * flat_size - size of the flat form of a command list
+ * @src: list built by the parser
+ * Return: size in bytes
+ */
+
+static size_t flat_size(CommandList *src)
+{
+	size_t n = FLAT_ALIGN(sizeof(*src)) + FLAT_ALIGN(src->count * sizeof(ListItem));
+	Pipeline *p;
+	int i, j, k;
+
+	for (i = 0; i < src->count; i++)
+	{
+		p = src->items[i].pipeline;
+		n += FLAT_ALIGN(sizeof(*p)) + FLAT_ALIGN(p->command_count * sizeof(Command));
+		for (j = 0; j < p->command_count; j++)
+		{
+			n += FLAT_ALIGN((p->commands[j].argc + 1) * sizeof(char *));
+			for (k = 0; k < p->commands[j].argc; k++)
+				n += FLAT_ALIGN(strlen(p->commands[j].argv[k]) + 1);
+			if (p->commands[j].input_file != NULL)
+				n += FLAT_ALIGN(strlen(p->commands[j].input_file) + 1);
+			if (p->commands[j].output_file != NULL)
+				n += FLAT_ALIGN(strlen(p->commands[j].output_file) + 1);
+		}
+		if (p->pipe_size_word != NULL)
+			n += FLAT_ALIGN(strlen(p->pipe_size_word) + 1);
+	}
+	return (n);
+}
+
+/**
+ * flat_alloc - carve aligned space out of a flat block
+ * @base: block
+ * @used: bytes used so far, advanced
+ * @n: bytes wanted
+ * Return: the space
+ */
+
+static void *flat_alloc(char *base, size_t *used, size_t n)
+{
+	void *p = base + *used;
+
+	*used += FLAT_ALIGN(n);
+	return (p);
+}
+
+/**
+ * flat_str - copy a string into a flat block
+ * @base: block
+ * @used: bytes used so far, advanced
+ * @s: string, may be NULL
+ * Return: the copy, or NULL
+ */
+
+static char *flat_str(char *base, size_t *used, const char *s)
+{
+	size_t n;
+	char *p;
+
+	if (s == NULL)
+		return (NULL);
+	n = strlen(s) + 1;
+	p = flat_alloc(base, used, n);
+	memcpy(p, s, n);
+	return (p);
+}
+
+/**
+ * flat_list - copy a command list into a block of flat_size() bytes
+ * @src: list built by the parser
+ * @base: block
+ * Return: the copy, which lives at @base
+ */
+
+static CommandList *flat_list(CommandList *src, char *base)
+{
+	size_t used = 0;
+	CommandList *dst = flat_alloc(base, &used, sizeof(*dst));
+	Pipeline *sp, *dp;
+	Command *sc, *dc;
+	int i, j, k;
+
+	*dst = *src;
+	dst->cap = src->count;
+	dst->arena = NULL;
+	dst->items = flat_alloc(base, &used, src->count * sizeof(ListItem));
+	for (i = 0; i < src->count; i++)
+	{
+		sp = src->items[i].pipeline;
+		dp = flat_alloc(base, &used, sizeof(*dp));
+		*dp = *sp;
+		dp->command_cap = sp->command_count;
+		dp->arena = NULL;
+		dp->commands = flat_alloc(base, &used, sp->command_count * sizeof(Command));
+		for (j = 0; j < sp->command_count; j++)
+		{
+			sc = &sp->commands[j];
+			dc = &dp->commands[j];
+			*dc = *sc;
+			dc->argv_cap = sc->argc + 1;
+			dc->path = NULL;
+			dc->argv = flat_alloc(base, &used, (sc->argc + 1) * sizeof(char *));
+			for (k = 0; k < sc->argc; k++)
+				dc->argv[k] = flat_str(base, &used, sc->argv[k]);
+			dc->argv[sc->argc] = NULL;
+			dc->name = dc->argv[0];
+			dc->input_file = flat_str(base, &used, sc->input_file);
+			dc->output_file = flat_str(base, &used, sc->output_file);
+		}
+		dp->pipe_size_word = flat_str(base, &used, sp->pipe_size_word);
+		dst->items[i].op = src->items[i].op;
+		dst->items[i].pipeline = dp;
+	}
+	return (dst);
+}
+
+/**
+ * lru_unlink - take an entry out of the LRU list
+ * @e: entry
+ */
+
+static void lru_unlink(struct line_entry *e)
+{
+	if (e->prev != NULL)
+		e->prev->next = e->next;
+	else
+		lru_head = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	else
+		lru_tail = e->prev;
+}
+
+/**
+ * lru_push - put an entry at the most recently used end
+ * @e: entry
+ */
+
+static void lru_push(struct line_entry *e)
+{
+	e->prev = NULL;
+	e->next = lru_head;
+	if (lru_head != NULL)
+		lru_head->prev = e;
+	lru_head = e;
+	if (lru_tail == NULL)
+		lru_tail = e;
+}
+
+/**
+ * line_evict - drop the least recently used entry
+ */
+
+static void line_evict(void)
+{
+	struct line_entry *e = lru_tail, **pp;
+
+	if (e == NULL)
+		return;
+	lru_unlink(e);
+	for (pp = &buckets[e->hash & (nbuckets - 1)]; *pp != e; pp = &(*pp)->hnext)
+		;
+	*pp = e->hnext;
+	free(e->list);
+	free(e);
+	nentries--;
+}
+
+/**
+ * line_rehash - move the entries to a bucket table sized for a capacity
+ * @cap: capacity the table should be sized for
+ *
+ * The table only ever grows.  If it cannot be allocated the old one is
+ * kept, which is slower but still correct.
+ * Return: 0, or -1 if there is no table at all
+ */
+
+static int line_rehash(long cap)
+{
+	struct line_entry **table, *e;
+	size_t n;
+
+	for (n = 16; (long)n < cap; n *= 2)
+		;
+	if (n <= nbuckets)
+		return (0);
+	table = calloc(n, sizeof(*table));
+	if (table == NULL)
+		return (nbuckets ? 0 : -1);
+	for (e = lru_head; e != NULL; e = e->next)
+	{
+		e->hnext = table[e->hash & (n - 1)];
+		table[e->hash & (n - 1)] = e;
+	}
+	free(buckets);
+	buckets = table;
+	nbuckets = n;
+	return (0);
+}
+
+/**
+ * linecache_lookup - find the parsed form of a line
+ * @line: raw line, not yet tokenized
+ * @len: length of @line
+ * @miss: receives, on a miss, a new entry holding the only copy of
+ * @line, for linecache_insert(); NULL on a hit or when the cache is off
+ * Return: the cached list, or NULL on a miss or when the cache is off
+ */
+
+CommandList *linecache_lookup(const char *line, size_t len, struct line_entry **miss)
+{
+	struct line_entry *e;
+	unsigned long hash;
+
+	*miss = NULL;
+	if (shell_options[OPT_LINECACHE].value <= 0)
+		return (NULL);
+	while (flush_pending && nentries > 0)
+		line_evict();
+	flush_pending = 0;
+	hash = line_hash(line, len);
+	for (e = nbuckets ? buckets[hash & (nbuckets - 1)] : NULL; e != NULL; e = e->hnext)
+	{
+		if (e->hash == hash && e->len == len && memcmp(e->line, line, len) == 0)
+		{
+			cache_hits++;
+			lru_unlink(e);
+			lru_push(e);
+			return (e->list);
+		}
+	}
+	cache_misses++;
+	/* the tokenizer is about to overwrite the line: keep the key here */
+	e = malloc(sizeof(*e) + len + 1);
+	if (e != NULL)
+	{
+		e->line = (char *)(e + 1);
+		memcpy(e->line, line, len);
+		e->line[len] = '\0';
+		e->len = len;
+		e->hash = hash;
+		*miss = e;
+	}
+	return (NULL);
+}
+
+/**
+ * linecache_insert - remember the parsed form of a line
+ * @e: entry from a linecache_lookup() miss, or NULL; it is owned by the
+ * cache from now on
+ * @list: the line's command list, or NULL if the line did not parse,
+ * which only drops @e
+ */
+
+void linecache_insert(struct line_entry *e, CommandList *list)
+{
+	long cap = shell_options[OPT_LINECACHE].value;
+	char *block;
+
+	if (e == NULL)
+		return;
+	/* "set -o linecache=N" may have raised the capacity since the last insert */
+	if (list == NULL || cap <= 0 || ((long)nbuckets < cap && line_rehash(cap) < 0))
+	{
+		free(e);
+		return;
+	}
+	while ((long)nentries >= cap)
+		line_evict();
+
+	block = malloc(flat_size(list));
+	if (block == NULL)
+	{
+		free(e);
+		return;
+	}
+	e->list = flat_list(list, block);
+	e->hnext = buckets[e->hash & (nbuckets - 1)];
+	buckets[e->hash & (nbuckets - 1)] = e;
+	lru_push(e);
+	nentries++;
+}
+
+/**
+ * linecache_builtin - the "linecache" builtin
+ * @args: argument vector; "-r" empties the cache
+ *
+ * The line running "linecache -r" may itself be cached, so the entries
+ * are only dropped before the next lookup.
+ * Return: 0
+ */
+
+int linecache_builtin(char **args)
+{
+	char buf[96];
+
+	if (args[1] != NULL && _strcmp(args[1], "-r") == 0)
+	{
+		flush_pending = 1;
+		return (0);
+	}
+	snprintf(buf, sizeof(buf), "hits\t%lu\nmisses\t%lu\nentries\t%lu/%ld\n",
+		 cache_hits, cache_misses, (unsigned long)nentries,
+		 shell_options[OPT_LINECACHE].value);
+	_puts(buf);
+	return (0);
+}
@@ -0,0 +1,288 @@
+#include "shell.h"
+
+static char *spawn_choices[] = {"posix_spawn", "vfork", "fork", NULL};
+static char *trace_choices[] = {"chrome", "jsonl", NULL};
+static char *time_choices[] = {"text", "json", NULL};
+
+/*
+ * Shell options, changed with "set -o name[=value]" / "set +o name".
+ * An option with an environment name also takes its initial value from
+ * that variable, and follows later assignments to it.  The order must
+ * match enum option_id.
+ */
+struct shell_option shell_options[] = {
+	{"spawn", "HSH_SPAWN", OPT_CHOICE, SPAWN_POSIX, spawn_choices},
+	{"pipesize", "PIPESIZE", OPT_SIZE, 0, NULL},
+	{"pipefail", NULL, OPT_BOOL, 0, NULL},
+	{"trace-timing", "HSH_TRACE_TIMING", OPT_BOOL, 0, NULL},
+	{"trace-fd", "HSH_TRACE_FD", OPT_INT, STDERR_FILENO, NULL},
+	{"trace-format", "HSH_TRACE_FORMAT", OPT_CHOICE, TRACE_CHROME, trace_choices},
+	{"time-format", "HSH_TIME_FORMAT", OPT_CHOICE, TIME_TEXT, time_choices},
+	{"linecache", "HSH_LINECACHE", OPT_SIZE, 64, NULL}
+};
+
+/* capacity the kernel actually gave the last sized pipe */
+long pipe_size_effective;
+
+#define OPTION_COUNT (sizeof(shell_options) / sizeof(shell_options[0]))
+
+/**
+ * option_find - look an option up by name
+ * @name: option name, may be followed by "=value"
+ * @len: length of the name part
+ * Return: the option, or NULL
+ */
+
+static struct shell_option *option_find(const char *name, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < OPTION_COUNT; i++)
+	{
+		if (strncmp(shell_options[i].name, name, len) == 0 &&
+		    shell_options[i].name[len] == '\0')
+			return (&shell_options[i]);
+	}
+	return (NULL);
+}
+
+/**
+ * parse_size - parse a non-negative number with an optional K, M or G
+ * suffix
+ * @value: text
+ * @n: receives the number
+ * Return: 0 on success, -1 if @value is not a valid size or does not fit
+ * in a long
+ */
+
+int parse_size(const char *value, long *n)
+{
+	long mult = 1;
+	char *end;
+
+	errno = 0;
+	*n = strtol(value, &end, 10);
+	if (end == value || *n < 0 || errno != 0)
+		return (-1);
+	switch (*end)
+	{
+	case 'G':
+	case 'g':
+		mult *= 1024;
+		/* fall through */
+	case 'M':
+	case 'm':
+		mult *= 1024;
+		/* fall through */
+	case 'K':
+	case 'k':
+		mult *= 1024;
+		end++;
+		break;
+	}
+	if (*end != '\0' || *n > LONG_MAX / mult)
+		return (-1);
+	*n *= mult;
+	return (0);
+}
+
+/**
+ * parse_int - parse a plain non-negative int
+ * @value: text
+ * @n: receives the number
+ * Return: 0 on success, -1 if @value is not a valid number
+ */
+
+static int parse_int(const char *value, long *n)
+{
+	char *end;
+
+	errno = 0;
+	*n = strtol(value, &end, 10);
+	if (end == value || *end != '\0' || *n < 0 || *n > INT_MAX || errno != 0)
+		return (-1);
+	return (0);
+}
+
+/**
+ * option_assign - parse and store an option value
+ * @opt: option
+ * @value: textual value
+ * Return: 0 on success, -1 if @value is not valid for @opt
+ */
+
+static int option_assign(struct shell_option *opt, const char *value)
+{
+	long n;
+	int i;
+
+	switch (opt->type)
+	{
+	case OPT_BOOL:
+		if (strcmp(value, "on") == 0 || strcmp(value, "1") == 0)
+			opt->value = 1;
+		else if (strcmp(value, "off") == 0 || strcmp(value, "0") == 0)
+			opt->value = 0;
+		else
+			return (-1);
+		return (0);
+	case OPT_INT:
+	case OPT_SIZE:
+		if ((opt->type == OPT_INT ? parse_int(value, &n) : parse_size(value, &n)) != 0)
+			return (-1);
+		opt->value = n;
+		return (0);
+	case OPT_CHOICE:
+		for (i = 0; opt->choices[i] != NULL; i++)
+		{
+			if (strcmp(opt->choices[i], value) == 0)
+			{
+				opt->value = i;
+				return (0);
+			}
+		}
+		return (-1);
+	}
+	return (-1);
+}
+
+/**
+ * options_init - take initial option values from the environment
+ * variables
+ */
+
+void options_init(void)
+{
+	char *value;
+	size_t i;
+
+	for (i = 0; i < OPTION_COUNT; i++)
+	{
+		if (shell_options[i].env == NULL)
+			continue;
+		value = var_get(shell_options[i].env);
+		if (value != NULL && *value != '\0')
+			option_assign(&shell_options[i], value);
+	}
+}
+
+/**
+ * options_var_set - follow an assignment to an option's variable
+ * @name: variable name, not necessarily terminated
+ * @len: length of @name
+ * @value: its new value
+ *
+ * As at startup, an empty value or one the option does not accept leaves
+ * the option alone.
+ */
+
+void options_var_set(const char *name, size_t len, const char *value)
+{
+	size_t i;
+
+	if (*value == '\0')
+		return;
+	for (i = 0; i < OPTION_COUNT; i++)
+	{
+		if (shell_options[i].env != NULL &&
+		    strncmp(shell_options[i].env, name, len) == 0 &&
+		    shell_options[i].env[len] == '\0')
+		{
+			option_assign(&shell_options[i], value);
+			return;
+		}
+	}
+}
+
+/**
+ * options_print - list every option and its value
+ */
+
+static void options_print(void)
+{
+	char buf[48];
+	size_t i;
+
+	for (i = 0; i < OPTION_COUNT; i++)
+	{
+		_puts(shell_options[i].name);
+		_puts("\t");
+		if (shell_options[i].type == OPT_BOOL)
+		{
+			_puts(shell_options[i].value ? "on" : "off");
+		}
+		else if (shell_options[i].type == OPT_CHOICE)
+		{
+			_puts(shell_options[i].choices[shell_options[i].value]);
+		}
+		else
+		{
+			snprintf(buf, sizeof(buf), "%ld", shell_options[i].value);
+			_puts(buf);
+		}
+		if (i == OPT_PIPESIZE && pipe_size_effective > 0)
+		{
+			snprintf(buf, sizeof(buf), " (effective %ld)", pipe_size_effective);
+			_puts(buf);
+		}
+		_puts("\n");
+	}
+}
+
+/**
+ * set_builtin - the "set" builtin
+ * @args: argument vector, args[0] is the command itself
+ * Return: 0 on success, 1 on an unknown option or bad value
+ */
+
+int set_builtin(char **args)
+{
+	struct shell_option *opt;
+	char *eq;
+	int enable, bad;
+
+	if (args[1] == NULL || (_strcmp(args[1], "-o") == 0 && args[2] == NULL))
+	{
+		options_print();
+		return (0);
+	}
+
+	for (args++; *args != NULL; args += 2)
+	{
+		if (_strcmp(args[0], "-o") != 0 && _strcmp(args[0], "+o") != 0)
+			break;
+		if (args[1] == NULL)
+			break;
+		enable = (args[0][0] == '-');
+		eq = strchr(args[1], '=');
+		opt = option_find(args[1], eq ? (size_t)(eq - args[1]) : strlen(args[1]));
+		if (opt == NULL)
+		{
+			_puts_fd(STDERR_FILENO, "set: ");
+			_puts_fd(STDERR_FILENO, args[1]);
+			_puts_fd(STDERR_FILENO, ": invalid option name\n");
+			return (1);
+		}
+		bad = 0;
+		if (eq != NULL)
+			bad = option_assign(opt, eq + 1);
+		else if (opt->type == OPT_BOOL)
+			opt->value = enable;
+		else
+			bad = -1;
+		if (bad)
+		{
+			_puts_fd(STDERR_FILENO, "set: ");
+			_puts_fd(STDERR_FILENO, args[1]);
+			_puts_fd(STDERR_FILENO, ": invalid value\n");
+			return (1);
+		}
+	}
+
+	if (*args != NULL)
+	{
+		_puts_fd(STDERR_FILENO, "set: usage: set [-o|+o name[=value]] ...\n");
+		return (2);
+	}
+	return (0);
+}
@@ -0,0 +1,236 @@
+#include "shell.h"
+#include <sys/uio.h>
+
+/*
+ * One buffer per standard output stream.  Everything the shell prints goes
+ * through _write_buf() and only reaches the kernel at a flush point: before
+ * a child is started, before the next line is read and at exit.
+ *
+ * While a command substitution runs a builtin in the shell process,
+ * stdout is captured: what would be written to it is appended to a
+ * memory buffer instead.
+ */
+static struct outbuf outbufs[] = {
+	{STDOUT_FILENO, 0, {0}},
+	{STDERR_FILENO, 0, {0}}
+};
+
+static int last_fd = -1;
+static struct strbuf *capture;
+
+/**
+ * strbuf_reserve - make room in a buffer
+ * @sb: buffer
+ * @n: number of free bytes wanted after the data
+ * Return: 0, or -1 if memory is exhausted
+ */
+
+int strbuf_reserve(struct strbuf *sb, size_t n)
+{
+	size_t cap;
+	char *tmp;
+
+	if (sb->len + n <= sb->cap)
+		return (0);
+	for (cap = sb->cap ? sb->cap * 2 : 256; cap < sb->len + n; cap *= 2)
+		;
+	tmp = realloc(sb->data, cap);
+	if (tmp == NULL)
+	{
+		_perror("malloc");
+		return (-1);
+	}
+	sb->data = tmp;
+	sb->cap = cap;
+	return (0);
+}
+
+/**
+ * strbuf_put - append bytes to a buffer
+ * @sb: buffer
+ * @s: bytes
+ * @n: number of bytes
+ * Return: 0, or -1 if memory is exhausted
+ */
+
+int strbuf_put(struct strbuf *sb, const char *s, size_t n)
+{
+	if (strbuf_reserve(sb, n) != 0)
+		return (-1);
+	memcpy(sb->data + sb->len, s, n);
+	sb->len += n;
+	return (0);
+}
+
+/**
+ * output_capture - send stdout into a buffer, or back to the descriptor
+ * @sb: buffer to append to, or NULL to stop capturing
+ * Return: the previous capture buffer, to be restored afterwards
+ */
+
+struct strbuf *output_capture(struct strbuf *sb)
+{
+	struct strbuf *prev = capture;
+
+	capture = sb;
+	return (prev);
+}
+
+/**
+ * outbuf_get - find the buffer attached to a file descriptor
+ * @fd: file descriptor
+ * Return: the buffer, or NULL when @fd is written unbuffered
+ */
+
+static struct outbuf *outbuf_get(int fd)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(outbufs) / sizeof(outbufs[0]); i++)
+	{
+		if (outbufs[i].fd == fd)
+			return (&outbufs[i]);
+	}
+	return (NULL);
+}
+
+/**
+ * write_vec - write an iovec array completely, retrying short writes
+ * @fd: file descriptor
+ * @iov: vectors, modified in place
+ * @iovcnt: number of vectors
+ * Return: 0 on success, -1 on error
+ */
+
+static int write_vec(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t n;
+
+	while (iovcnt > 0)
+	{
+		n = writev(fd, iov, iovcnt);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len)
+		{
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0)
+		{
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return (0);
+}
+
+/**
+ * _flush - write out whatever is pending for a file descriptor
+ * @fd: file descriptor
+ * Return: 0 on success, -1 on error
+ */
+
+int _flush(int fd)
+{
+	struct outbuf *ob = outbuf_get(fd);
+	struct iovec iov;
+
+	if (ob == NULL || ob->len == 0)
+		return (0);
+
+	iov.iov_base = ob->data;
+	iov.iov_len = ob->len;
+	ob->len = 0;
+	return (write_vec(fd, &iov, 1));
+}
+
+/**
+ * _flush_all - flush every output buffer
+ */
+
+void _flush_all(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(outbufs) / sizeof(outbufs[0]); i++)
+		_flush(outbufs[i].fd);
+}
+
+/**
+ * _write_buf - queue bytes for a file descriptor
+ * @fd: file descriptor
+ * @buf: bytes to write
+ * @n: number of bytes
+ *
+ * stdout and stderr usually share a terminal, so switching from one to the
+ * other flushes the first to keep messages in order.  Data that does not
+ * fit is sent together with the pending bytes in a single writev().
+ * Return: @n on success, -1 on error
+ */
+
+ssize_t _write_buf(int fd, const char *buf, size_t n)
+{
+	struct outbuf *ob = outbuf_get(fd);
+	struct iovec iov[2];
+
+	if (fd == STDOUT_FILENO && capture != NULL)
+		return (strbuf_put(capture, buf, n) == 0 ? (ssize_t)n : -1);
+	if (last_fd != fd && last_fd != -1)
+		_flush(last_fd);
+	last_fd = fd;
+
+	if (ob == NULL)
+	{
+		iov[0].iov_base = (char *)buf;
+		iov[0].iov_len = n;
+		return (write_vec(fd, iov, 1) == 0 ? (ssize_t)n : -1);
+	}
+
+	if (ob->len + n <= OUTBUF_SIZE)
+	{
+		memcpy(ob->data + ob->len, buf, n);
+		ob->len += n;
+		return (n);
+	}
+
+	iov[0].iov_base = ob->data;
+	iov[0].iov_len = ob->len;
+	iov[1].iov_base = (char *)buf;
+	iov[1].iov_len = n;
+	ob->len = 0;
+	return (write_vec(fd, iov, 2) == 0 ? (ssize_t)n : -1);
+}
+
+/**
+ * _puts_fd - print a string to a file descriptor
+ * @fd: file descriptor
+ * @str: string
+ * Return: void
+ */
+
+void _puts_fd(int fd, char *str)
+{
+	_write_buf(fd, str, _strlen(str));
+}
+
+/**
+ * _perror - print a message followed by the description of errno
+ * @s: message prefix
+ * Return: void
+ */
+
+void _perror(char *s)
+{
+	char *msg = strerror(errno);
+
+	_puts_fd(STDERR_FILENO, s);
+	_puts_fd(STDERR_FILENO, ": ");
+	_puts_fd(STDERR_FILENO, msg);
+	_puts_fd(STDERR_FILENO, "\n");
+}
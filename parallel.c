@@ -0,0 +1,350 @@
+#include "shell.h"
+#include <sys/mman.h>
+
+/*
+ * The "parallel" builtin: run a command once per input line, with at most
+ * -j of them at a time.
+ *
+ *	parallel [-j N] [-a file] command [arg ...]
+ *
+ * Every "{}" in the arguments is replaced by the line; without one the
+ * line is appended as the last argument.  Each run writes its stdout
+ * into a memfd of its own, which is copied out in one piece when the run
+ * finishes, so the output of concurrent runs never interleaves.  Runs are
+ * reaped through the pidfd reaper, and the next one starts as soon as
+ * any slot's pidfd reports an exit.
+ */
+
+#define PAR_READ_SIZE 65536
+
+struct par_slot {
+	struct child child;
+	int out;
+	int busy;
+};
+
+struct par_input {
+	int fd;
+	char *buf;
+	size_t len;
+	size_t pos;
+	size_t cap;
+	int eof;
+};
+
+/**
+ * par_next_line - read the next input line
+ * @in: input
+ * Return: the line, valid until the next call, or NULL at end of input
+ */
+
+static char *par_next_line(struct par_input *in)
+{
+	char *nl, *tmp;
+	ssize_t n;
+
+	while (1)
+	{
+		nl = memchr(in->buf + in->pos, '\n', in->len - in->pos);
+		if (nl != NULL || (in->eof && in->pos < in->len))
+		{
+			if (nl == NULL)
+				nl = in->buf + in->len;
+			*nl = '\0';
+			tmp = in->buf + in->pos;
+			in->pos = nl - in->buf + (nl < in->buf + in->len);
+			return (tmp);
+		}
+		if (in->eof)
+			return (NULL);
+
+		memmove(in->buf, in->buf + in->pos, in->len - in->pos);
+		in->len -= in->pos;
+		in->pos = 0;
+		if (in->cap - in->len < PAR_READ_SIZE)
+		{
+			tmp = realloc(in->buf, in->cap * 2 + 1);
+			if (tmp == NULL)
+				return (NULL);
+			in->buf = tmp;
+			in->cap *= 2;
+		}
+		n = read(in->fd, in->buf + in->len, in->cap - in->len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			in->eof = 1;
+		else
+			in->len += n;
+	}
+}
+
+/**
+ * par_subst - put the input line in place of every "{}" in a word
+ * @word: template word
+ * @line: input line
+ * Return: @word itself if it has no "{}", otherwise a malloc'd copy with
+ * the substitutions, or NULL if memory is exhausted
+ */
+
+static char *par_subst(char *word, char *line)
+{
+	size_t n = 0, len = strlen(line);
+	char *p, *out, *dst;
+
+	for (p = strstr(word, "{}"); p != NULL; p = strstr(p + 2, "{}"))
+		n++;
+	if (n == 0)
+		return (word);
+	out = malloc(strlen(word) + n * len + 1);
+	if (out == NULL)
+		return (NULL);
+	for (dst = out; *word != '\0'; )
+	{
+		if (word[0] == '{' && word[1] == '}')
+		{
+			memcpy(dst, line, len);
+			dst += len;
+			word += 2;
+		}
+		else
+		{
+			*dst++ = *word++;
+		}
+	}
+	*dst = '\0';
+	return (out);
+}
+
+/**
+ * par_argv_free - free an argument vector built by par_argv()
+ * @run: argument vector
+ * @argv: command template it was built from
+ * @argc: number of words in @argv
+ */
+
+static void par_argv_free(char **run, char **argv, int argc)
+{
+	int i;
+
+	for (i = 0; i < argc && run[i] != NULL; i++)
+	{
+		if (run[i] != argv[i])
+			free(run[i]);
+	}
+	free(run);
+}
+
+/**
+ * par_argv - build the argument vector for one input line
+ * @argv: command template
+ * @argc: number of words in @argv
+ * @line: input line
+ * Return: the vector, or NULL if memory is exhausted
+ */
+
+static char **par_argv(char **argv, int argc, char *line)
+{
+	char **run = calloc(argc + 2, sizeof(char *));
+	int i, placed = 0;
+
+	if (run == NULL)
+		return (NULL);
+	for (i = 0; i < argc; i++)
+	{
+		run[i] = par_subst(argv[i], line);
+		if (run[i] == NULL)
+		{
+			par_argv_free(run, argv, argc);
+			return (NULL);
+		}
+		placed |= run[i] != argv[i];
+	}
+	if (!placed)
+		run[argc] = line;
+	return (run);
+}
+
+/**
+ * par_start - start one run in a free slot
+ * @slot: slot
+ * @argv: command template
+ * @argc: number of words in @argv
+ * @line: input line
+ * Return: 0 on success, -1 if the run could not be started
+ */
+
+static int par_start(struct par_slot *slot, char **argv, int argc, char *line)
+{
+	char **run = par_argv(argv, argc, line);
+	const struct builtin *bi = builtin_lookup(argv[0]);
+	int in, out;
+	char *path;
+	pid_t pid;
+
+	if (run == NULL)
+		return (-1);
+	slot->out = memfd_create("parallel", MFD_CLOEXEC);
+	out = slot->out >= 0 ? slot->out : STDOUT_FILENO;
+	in = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (bi != NULL)
+	{
+		pid = spawn_builtin(bi, run, in >= 0 ? in : STDIN_FILENO, out, -1);
+	}
+	else
+	{
+		path = find_command_in_path(run[0]);
+		pid = spawn_command(path ? path : run[0], run,
+				    in >= 0 ? in : STDIN_FILENO, out, -1);
+	}
+	if (in >= 0)
+		close(in);
+	par_argv_free(run, argv, argc);
+
+	child_init(&slot->child, pid, 127);
+	if (pid < 0)
+	{
+		if (slot->out >= 0)
+			close(slot->out);
+		return (-1);
+	}
+	reap_register(&slot->child);
+	slot->busy = 1;
+	return (0);
+}
+
+/**
+ * par_finish - copy out a finished run's output and free its slot
+ * @slot: slot
+ * Return: exit status of the run
+ */
+
+static int par_finish(struct par_slot *slot)
+{
+	void (*old_pipe)(int);
+
+	slot->busy = 0;
+	if (slot->out < 0)
+		return (slot->child.status);
+	old_pipe = signal(SIGPIPE, SIG_IGN);
+	if (lseek(slot->out, 0, SEEK_SET) == 0)
+		copy_fd(slot->out, STDOUT_FILENO);
+	signal(SIGPIPE, old_pipe);
+	close(slot->out);
+	return (slot->child.status);
+}
+
+/**
+ * par_reap - wait until at least one run has finished and retire it
+ * @slots: slots
+ * @nslots: number of slots
+ * @failed: incremented for every retired run that failed
+ * Return: number of runs retired
+ */
+
+static int par_reap(struct par_slot *slots, int nslots, int *failed)
+{
+	int i, found = 0;
+
+	while (!found)
+	{
+		for (i = 0; i < nslots; i++)
+		{
+			if (slots[i].busy && !slots[i].child.done && slots[i].child.pidfd < 0)
+				reap_wait(&slots[i].child, 1);
+			if (slots[i].busy && slots[i].child.done)
+			{
+				*failed += par_finish(&slots[i]) != 0;
+				found++;
+			}
+		}
+		if (!found)
+			reap_poll(-1);
+	}
+	return (found);
+}
+
+/**
+ * par_usage - report a usage error
+ * Return: 2
+ */
+
+static int par_usage(void)
+{
+	_puts_fd(STDERR_FILENO, "parallel: usage: parallel [-j N] [-a file] command [arg ...]\n");
+	return (2);
+}
+
+/**
+ * parallel_builtin - the "parallel" builtin
+ * @args: argument vector
+ *
+ * Return: 0 if every run succeeded, otherwise the number of failed runs,
+ * capped at 101; 2 on a usage error, 1 if the input cannot be opened
+ */
+
+int parallel_builtin(char **args)
+{
+	struct par_input in;
+	struct par_slot *slots;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	char *file = NULL, *line;
+	int i, argc, running = 0, failed = 0;
+
+	for (args++; *args != NULL && (*args)[0] == '-'; args += 2)
+	{
+		if (args[1] == NULL)
+			return (par_usage());
+		if (_strcmp(args[0], "-j") == 0)
+			jobs = atol(args[1]);
+		else if (_strcmp(args[0], "-a") == 0)
+			file = args[1];
+		else
+			return (par_usage());
+	}
+	if (*args == NULL || jobs < 1)
+		return (par_usage());
+	for (argc = 0; args[argc] != NULL; argc++)
+		;
+
+	in.fd = file ? open(file, O_RDONLY | O_CLOEXEC) : STDIN_FILENO;
+	if (in.fd < 0)
+	{
+		_puts_fd(STDERR_FILENO, "parallel: ");
+		_perror(file);
+		return (1);
+	}
+	in.cap = PAR_READ_SIZE * 2;
+	in.buf = malloc(in.cap + 1);
+	slots = calloc(jobs, sizeof(*slots));
+	if (in.buf == NULL || slots == NULL)
+	{
+		_perror("malloc");
+		free(in.buf);
+		free(slots);
+		return (1);
+	}
+	in.len = in.pos = 0;
+	in.eof = 0;
+
+	_flush_all();
+	while ((line = par_next_line(&in)) != NULL)
+	{
+		if (running == jobs)
+			running -= par_reap(slots, jobs, &failed);
+		for (i = 0; slots[i].busy; i++)
+			;
+		if (par_start(&slots[i], args, argc, line) == 0)
+			running++;
+		else
+			failed++;
+	}
+	while (running > 0)
+		running -= par_reap(slots, jobs, &failed);
+
+	if (file != NULL)
+		close(in.fd);
+	free(in.buf);
+	free(slots);
+	return (failed > 101 ? 101 : failed);
+}
@@ -3,81 +3,165 @@
 #include <string.h>
 #include <stdio.h>
 
+/* redirections written before the command they belong to, as in "< f cat" */
+struct pending_redirs {
+    char *input_file;
+    char *output_file;
+    int append;
+    int expand;
+};
 
-static void handle_token(CList tokens, Pipeline *pipeline, int *command_index, char *errmsg, size_t errmsg_sz);
+static void handle_token(CList tokens, Pipeline *pipeline, int *command_index, struct pending_redirs *pending, char *errmsg, size_t errmsg_sz);
+static int is_separator(TokenType type);
+static enum list_op separator_op(TokenType type);
 
-Pipeline *parse_tokens(CList tokens, char *errmsg, size_t errmsg_sz) {
+/*
+ * Parses a whole line into a command list in one pass.  Separators close
+ * the current pipeline; '&' also marks it as a background job.
+ */
+CommandList *parse_tokens(Arena *arena, CList tokens, char *errmsg, size_t errmsg_sz) {
     
-    Pipeline *pipeline = Pipeline_new();
+    CommandList *list = CommandList_new(arena);
+    Pipeline *pipeline = CommandList_add_pipeline(list, LIST_SEQ);
     int command_index = 0; 
+    struct pending_redirs pending = {NULL, NULL, 0, 0};
+    Token token;
 
     if (tokens == NULL) return NULL;
     
+    *errmsg = '\0';
     while (CL_length(tokens) > 0) {
-        handle_token(tokens, pipeline, &command_index, errmsg, errmsg_sz);
-        if (*errmsg != '\0') { 
-            Pipeline_free(pipeline);
-            CL_free(tokens); 
+        token = CL_nth(tokens, 0);
+        if (!is_separator(token.type)) {
+            handle_token(tokens, pipeline, &command_index, &pending, errmsg, errmsg_sz);
+            if (*errmsg != '\0') { 
+                return NULL;
+            }
+            continue;
+        }
+
+        if (pipeline->command_count == 0) {
+            snprintf(errmsg, errmsg_sz, "syntax error near unexpected token '%s'\n", token.value);
+            return NULL;
+        }
+        if (command_index == 0) {
+            snprintf(errmsg, errmsg_sz, "syntax error: missing command after '|'\n");
+            return NULL;
+        }
+        pipeline->background = token.type == TOK_AMP;
+        TOK_consume(tokens);
+        if (CL_length(tokens) > 0) {
+            pipeline = CommandList_add_pipeline(list, separator_op(token.type));
+            command_index = 0;
+        } else if (token.type == TOK_AND_IF || token.type == TOK_OR_IF) {
+            snprintf(errmsg, errmsg_sz, "syntax error: missing command after '%s'\n", token.value);
             return NULL;
         }
     }
-    return pipeline;
+    if (pipeline->command_count > 0 && command_index == 0) {
+        snprintf(errmsg, errmsg_sz, "syntax error: missing command after '|'\n");
+        return NULL;
+    }
+    return list;
+}
+
+static int is_separator(TokenType type) {
+    return type == TOK_SEMI || type == TOK_AMP || type == TOK_AND_IF || type == TOK_OR_IF;
+}
+
+static enum list_op separator_op(TokenType type) {
+    switch (type) {
+        case TOK_AND_IF:
+            return LIST_AND;
+        case TOK_OR_IF:
+            return LIST_OR;
+        default:
+            return LIST_SEQ;
+    }
 }
 
-static void handle_token(CList tokens, Pipeline *pipeline, int *command_index, char *errmsg __attribute__((unused)), size_t errmsg_sz __attribute__((unused))) {
+static void handle_token(CList tokens, Pipeline *pipeline, int *command_index, struct pending_redirs *pending, char *errmsg, size_t errmsg_sz) {
     Token token = CL_nth(tokens, 0);
 
     if (CL_length(tokens) == 0) {
-        _puts("Empty token list");
+        snprintf(errmsg, errmsg_sz, "Empty token list\n");
         return;
     }
 
     switch (token.type) {
         case TOK_WORD:
         case TOK_QUOTED_WORD:
-            if (*command_index == 0 || CL_length(pipeline->commands[*command_index - 1].args) > 0) {
+            if (*command_index == 0 && token.type == TOK_WORD && !pipeline->timed &&
+                pipeline->command_count == 0 && strcmp(token.value, "time") == 0) {
+                /* reserved word: only where a pipeline starts */
+                pipeline->timed = 1;
+            } else if (*command_index == 0 && token.type == TOK_WORD &&
+                strncmp(token.value, "PIPESIZE=", 9) == 0 && CL_length(tokens) > 1 &&
+                (CL_nth(tokens, 1).type == TOK_WORD || CL_nth(tokens, 1).type == TOK_QUOTED_WORD)) {
+                /*
+                 * per-pipeline override of "set -o pipesize" in front of a
+                 * command; on its own it is an ordinary assignment
+                 */
+                if (token.flags & TOKF_EXPAND) {
+                    pipeline->pipe_size_word = token.value + 9;
+                    pipeline->expand = 1;
+                } else if (parse_size(token.value + 9, &pipeline->pipe_size) != 0) {
+                    snprintf(errmsg, errmsg_sz, "invalid pipe size '%s'\n", token.value + 9);
+                }
+            } else if (*command_index == 0) {
                 Pipeline_add_command(pipeline, token.value);
                 (*command_index)++;
+                if ((token.flags & TOKF_EXPAND) || pending->expand) Pipeline_mark_expand(pipeline);
+                if (pending->input_file != NULL)
+                    Pipeline_set_input_file(pipeline, pending->input_file);
+                if (pending->output_file != NULL)
+                    Pipeline_set_output_file(pipeline, pending->output_file, pending->append);
+                pending->input_file = NULL;
+                pending->output_file = NULL;
+                pending->expand = 0;
             } else {
                 Pipeline_add_argument(pipeline, token.value);
+                if (token.flags & TOKF_EXPAND) Pipeline_mark_expand(pipeline);
             }
             break;
 
         case TOK_PIPE:
-            
+            if (*command_index == 0) {
+                snprintf(errmsg, errmsg_sz, "syntax error near unexpected token '|'\n");
+                break;
+            }
             *command_index = 0;
             break;
 
         case TOK_LESSTHAN:
-            if (CL_length(tokens) > 1) {
+        case TOK_GREATERTHAN:
+        case TOK_APPEND:
+            if (CL_length(tokens) > 1 &&
+                (CL_nth(tokens, 1).type == TOK_WORD || CL_nth(tokens, 1).type == TOK_QUOTED_WORD)) {
                 Token next_token = CL_nth(tokens, 1);
-                if (next_token.type == TOK_WORD || next_token.type == TOK_QUOTED_WORD) {
+                if (*command_index == 0 && token.type == TOK_LESSTHAN) {
+                    pending->input_file = next_token.value;
+                } else if (*command_index == 0) {
+                    pending->output_file = next_token.value;
+                    pending->append = token.type == TOK_APPEND;
+                } else if (token.type == TOK_LESSTHAN) {
                     Pipeline_set_input_file(pipeline, next_token.value);
-                    TOK_consume(tokens); 
                 } else {
-                    _puts( "Expected filename after '<'");
+                    Pipeline_set_output_file(pipeline, next_token.value, token.type == TOK_APPEND);
                 }
-            } else {
-                _puts("Expected filename after '<'");
-            }
-            break;
-
-        case TOK_GREATERTHAN:
-            if (CL_length(tokens) > 1) {
-                Token next_token = CL_nth(tokens, 1);
-                if (next_token.type == TOK_WORD || next_token.type == TOK_QUOTED_WORD) {
-                    Pipeline_set_output_file(pipeline, next_token.value);
-                    TOK_consume(tokens); 
-                } else {
-                    _puts("Expected filename after '>'");
+                if ((next_token.flags & TOKF_EXPAND) && *command_index == 0) {
+                    pending->expand = 1;
+                } else if (next_token.flags & TOKF_EXPAND) {
+                    Pipeline_mark_expand(pipeline);
                 }
+                TOK_consume(tokens); 
             } else {
-                _puts("Expected filename after '>'");
+                snprintf(errmsg, errmsg_sz, "Expected filename after '%s'\n", token.value);
             }
             break;
 
         default:
-            _puts("Unexpected token");
+            snprintf(errmsg, errmsg_sz, "Unexpected token\n");
             break;
     }
 
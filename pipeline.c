@@ -5,83 +5,128 @@
 
 
 
-Pipeline *Pipeline_new() {
-    Pipeline *pipeline = malloc(sizeof(Pipeline));
+Pipeline *Pipeline_new(Arena *arena) {
+    Pipeline *pipeline = arena_alloc(arena, sizeof(Pipeline));
     pipeline->commands = NULL;
     pipeline->command_count = 0;
-    pipeline->input_file = NULL;
-    pipeline->output_file = NULL;
+    pipeline->command_cap = 0;
+    pipeline->pipe_size = -1;
+    pipeline->pipe_size_word = NULL;
+    pipeline->background = 0;
+    pipeline->timed = 0;
+    pipeline->expand = 0;
+    pipeline->arena = arena;
     return pipeline;
 }
 
-void Pipeline_free(Pipeline *pipeline) {
-    int i;
-    if (pipeline == NULL) return;
-
-    for (i = 0; i < pipeline->command_count; ++i) {
-        Command *command = &pipeline->commands[i];
-        
-        while (CL_length(command->args) > 0) {
-            Token arg = CL_pop(command->args);
-            if (arg.value != NULL) {
-                free(arg.value);
-                arg.value = NULL; 
-            }
-        }
-        CL_free(command->args); 
-        if (command->name != NULL) {
-            free(command->name); 
-            command->name = NULL; 
-        }
-    }
-
-    if (pipeline->commands != NULL) {
-        free(pipeline->commands);
-        pipeline->commands = NULL;
-    }
-
-    if (pipeline->input_file != NULL) {
-        free(pipeline->input_file);
-        pipeline->input_file = NULL;
-    }
+/*
+ * Redirections belong to the last command added, so "a > f | b" sends
+ * a's output to f.  Strings handed to the setters below must live at
+ * least as long as the pipeline, which in practice means they come from
+ * the same arena.
+ */
 
-    if (pipeline->output_file != NULL) {
-        free(pipeline->output_file);
-        pipeline->output_file = NULL; 
-    }
-
-    free(pipeline);
+void Pipeline_set_input_file(Pipeline *pipeline, char *filename) {
+    if (pipeline->command_count > 0)
+        pipeline->commands[pipeline->command_count - 1].input_file = filename;
 }
 
+void Pipeline_set_output_file(Pipeline *pipeline, char *filename, int append) {
+    Command *command;
 
-void Pipeline_set_input_file(Pipeline *pipeline, const char *filename) {
-    if (pipeline->input_file != NULL) free(pipeline->input_file);
-    pipeline->input_file = strdup(filename);
+    if (pipeline->command_count == 0) return;
+    command = &pipeline->commands[pipeline->command_count - 1];
+    command->output_file = filename;
+    command->append = append;
 }
 
-void Pipeline_set_output_file(Pipeline *pipeline, const char *filename) {
-    if (pipeline->output_file != NULL) free(pipeline->output_file);
-    pipeline->output_file = strdup(filename);
-}
+void Pipeline_add_command(Pipeline *pipeline, char *command_name) {
+    Command *command;
+
+    if (pipeline->command_count == pipeline->command_cap) {
+        int cap = pipeline->command_cap ? pipeline->command_cap * 2 : 4;
+        Command *commands = arena_alloc(pipeline->arena, sizeof(Command) * cap);
+        if (pipeline->command_count > 0)
+            memcpy(commands, pipeline->commands, sizeof(Command) * pipeline->command_count);
+        pipeline->commands = commands;
+        pipeline->command_cap = cap;
+    }
 
-void Pipeline_add_command(Pipeline *pipeline, const char *command_name) {
-    pipeline->commands = realloc(pipeline->commands, sizeof(Command) * (pipeline->command_count + 1));
-    pipeline->commands[pipeline->command_count].name = strdup(command_name);
-    pipeline->commands[pipeline->command_count].args = CL_new();
+    command = &pipeline->commands[pipeline->command_count];
+    command->name = command_name;
+    command->argv_cap = 8;
+    command->argv = arena_alloc(pipeline->arena, sizeof(char *) * command->argv_cap);
+    command->argv[0] = command_name;
+    command->argv[1] = NULL;
+    command->argc = 1;
+    command->builtin = builtin_lookup(command_name);
+    command->path = NULL;
+    command->expand = 0;
+    command->input_file = NULL;
+    command->output_file = NULL;
+    command->append = 0;
     pipeline->command_count++;
 }
 
-void Pipeline_add_argument(Pipeline *pipeline, const char *argument) {
+/*
+ * Arguments go straight into the command's NULL-terminated argv, which
+ * doubles when full, so execution hands it to exec without copying.
+ */
+void Pipeline_add_argument(Pipeline *pipeline, char *argument) {
     
-    Token argToken;
-    Command *last_command = &pipeline->commands[pipeline->command_count - 1];
+    Command *last_command;
     
     if (pipeline == NULL || pipeline->command_count == 0 || argument == NULL) return;
 
-    
-    argToken.type = TOK_WORD;
-    argToken.value = strdup(argument);
+    last_command = &pipeline->commands[pipeline->command_count - 1];
+    if (last_command->argc + 1 == last_command->argv_cap) {
+        char **argv = arena_alloc(pipeline->arena, sizeof(char *) * last_command->argv_cap * 2);
+        memcpy(argv, last_command->argv, sizeof(char *) * last_command->argc);
+        last_command->argv = argv;
+        last_command->argv_cap *= 2;
+    }
+
+    last_command->argv[last_command->argc++] = argument;
+    last_command->argv[last_command->argc] = NULL;
+}
+
+CommandList *CommandList_new(Arena *arena) {
+    CommandList *list = arena_alloc(arena, sizeof(CommandList));
 
-    CL_append(last_command->args, *(CListElementType *)&argToken);
+    list->items = NULL;
+    list->count = 0;
+    list->cap = 0;
+    list->arena = arena;
+    return list;
 }
 
+/*
+ * Records that the word just added to the last command holds parameters,
+ * which are expanded each time the pipeline runs.
+ */
+void Pipeline_mark_expand(Pipeline *pipeline) {
+    if (pipeline->command_count > 0)
+        pipeline->commands[pipeline->command_count - 1].expand = 1;
+    pipeline->expand = 1;
+}
+
+/*
+ * Starts the next pipeline of a list; @op joins it to the one before.
+ */
+Pipeline *CommandList_add_pipeline(CommandList *list, enum list_op op) {
+    ListItem *item;
+
+    if (list->count == list->cap) {
+        int cap = list->cap ? list->cap * 2 : 4;
+        ListItem *items = arena_alloc(list->arena, sizeof(ListItem) * cap);
+        if (list->count > 0)
+            memcpy(items, list->items, sizeof(ListItem) * list->count);
+        list->items = items;
+        list->cap = cap;
+    }
+
+    item = &list->items[list->count++];
+    item->pipeline = Pipeline_new(list->arena);
+    item->op = op;
+    return item->pipeline;
+}
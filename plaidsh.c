@@ -1,29 +1,104 @@
 #include "shell.h"
 
+Arena line_arena;
+int last_status;
+int interactive;
+
 /**
- * main - check the code
+ * run_line - tokenize, parse and execute one line, which may hold a
+ * whole command list
+ * @input: NUL-terminated line without its newline; modified in place
+ * @flags: EXEC_* flags passed on to execute_list
  *
- * Return: Always 0.
+ * Everything built for the line comes from line_arena, which is reset
+ * here, so the previous line's tokens and pipeline die at this point.
+ * A line seen before comes out of the line cache and is not tokenized or
+ * parsed again.  On a miss the cache takes the only copy of the line,
+ * which becomes the key of its entry; the tokenizer works on @input.
  */
 
-int main(void)
+void run_line(char *input, int flags)
 {
-    char *input;
     CList tokens = NULL;
+    CommandList *list;
+    char errmsg[128];
+    struct line_entry *miss;
+    size_t len;
+    long t_line, t0;
+
+    arena_reset(&line_arena);
+    if (input[0] == '\0') 
+    { 
+        return;
+    }
+    
+    t_line = t0 = trace_begin();
+    len = strlen(input);
+    list = linecache_lookup(input, len, &miss);
+    if (list != NULL)
+    {
+        trace_end("linecache", NULL, t0);
+        execute_list(list, &line_arena, flags);
+        trace_end("line", NULL, t_line);
+        return;
+    }
+
+    t0 = trace_begin();
+    tokens = TOK_tokenize_input(&line_arena, input, errmsg, sizeof(errmsg));
+    trace_end("tokenize", NULL, t0);
+
+    if (tokens == NULL)
+    {
+        _puts_fd(STDERR_FILENO, errmsg);
+        last_status = 2;
+        linecache_insert(miss, NULL);
+    }
+    else
+    {
+        t0 = trace_begin();
+        list = parse_tokens(&line_arena, tokens, errmsg, sizeof(errmsg));
+        trace_end("parse", NULL, t0);
+        linecache_insert(miss, list);
+        if (list == NULL)
+        {
+            _puts_fd(STDERR_FILENO, errmsg);
+            last_status = 2;
+        }
+        else
+        {
+            execute_list(list, &line_arena, flags);
+        }
+    }
+    trace_end("line", NULL, t_line);
+}
+
+/**
+ * run_interactive - prompt for and run lines until end of input
+ *
+ * The line buffer is kept between iterations; getline only grows it.
+ */
+
+static void run_interactive(void)
+{
+    char *input = NULL;
     size_t len = 0;
     ssize_t nread = 0;
-    char errmsg[128];
+    long t0;
 
     while (1)
     {
+        jobs_notify();
         _puts("#cisfun$ ");
-        fflush(stdout);
+        _flush_all();
 
+        t0 = trace_begin();
         nread = getline(&input, &len, stdin);
+        trace_end("read", NULL, t0);
         if (nread == -1)
         {
             if (errno == EINTR) 
             {
+                clearerr(stdin);
                 continue;
             }
             else
@@ -37,39 +112,52 @@ int main(void)
             input[nread-1] = '\0';
         }
 
-        if (input[0] == '\0') 
-        { 
-            continue;
-        }
-        
-        tokens = TOK_tokenize_input(input, errmsg, sizeof(errmsg));
-
-        if (tokens == NULL)
-        {
-            _puts( errmsg);
-        }
-        else
-        {
-            Pipeline *pipeline = parse_tokens(tokens, errmsg, sizeof(errmsg));
-            if (pipeline == NULL)
-            {
-                _puts(errmsg);
-            }
-            else
-            {
-                execute_pipeline(pipeline);
-                Pipeline_free(pipeline);
-            }
-
-            TOK_free_tokens(tokens);
-        }
-
-        free(input);
-        input = NULL;
-        len = 0;
+        run_line(input, 0);
     }
-    return 0;
-} 
+    free(input);
+}
+
+/**
+ * main - run a command string, a script, or commands from stdin
+ * @argc: argument count
+ * @argv: arguments; "-c string" or an optional script path
+ *
+ * Without either, stdin is read interactively with a prompt when it is
+ * a terminal and in batch mode otherwise.
+ * Return: status of the last command, 2 on a usage error, or 127 if the
+ * script cannot be opened
+ */
 
+int main(int argc, char **argv)
+{
+    int status = 0;
 
+    atexit(_flush_all);
+    vars_init();
+    options_init();
+    arena_init(&line_arena, LINE_ARENA_CHUNK);
 
+    if (argc > 1 && _strcmp(argv[1], "-c") == 0)
+    {
+        if (argc < 3)
+        {
+            _puts_fd(STDERR_FILENO, "hsh: -c: option requires an argument\n");
+            return 2;
+        }
+        run_string(argv[2]);
+    }
+    else if (argc > 1)
+    {
+        status = run_script(argv[1]);
+    }
+    else if (isatty(STDIN_FILENO))
+    {
+        interactive = 1;
+        run_interactive();
+    }
+    else
+    {
+        run_fd(STDIN_FILENO);
+    }
+    return status ? status : last_status;
+}
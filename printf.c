@@ -0,0 +1,366 @@
+#include "shell.h"
+
+/*
+ * The "echo" and "printf" builtins.  Output goes through _write_buf(), so
+ * it is buffered with everything else the shell prints, and a run of
+ * plain bytes is queued with one call rather than byte by byte.
+ */
+
+/**
+ * hex_value - value of a hexadecimal digit
+ * @c: character
+ * Return: its value, or -1 if it is not a hexadecimal digit
+ */
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return (c - '0');
+	if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+		return ((c | 0x20) - 'a' + 10);
+	return (-1);
+}
+
+/**
+ * put_escape - decode one backslash escape and queue its byte
+ * @s: the byte after the backslash
+ * @zero_octal: 1 if octal escapes are written \0nnn (echo -e, %b), 0 if
+ * they are written \nnn (printf formats)
+ * @stop: set to 1 on "\c"
+ * Return: number of bytes of @s consumed
+ */
+
+static size_t put_escape(const char *s, int zero_octal, int *stop)
+{
+	static const char from[] = "\\abefnrtv\"", to[] = "\\\a\b\033\f\n\r\t\v\"";
+	const char *p = strchr(from, *s);
+	size_t n = 0, max = 3;
+	int c = 0;
+
+	if (*s != '\0' && p != NULL)
+	{
+		_write_buf(STDOUT_FILENO, &to[p - from], 1);
+		return (1);
+	}
+	if (*s == 'c')
+	{
+		*stop = 1;
+		return (1);
+	}
+	if (*s == 'x' && hex_value(s[1]) >= 0)
+	{
+		for (n = 1; n < 3 && hex_value(s[n]) >= 0; n++)
+			c = c * 16 + hex_value(s[n]);
+	}
+	else if (*s >= '0' && *s <= '7')
+	{
+		if (zero_octal && *s == '0')
+		{
+			n = 1;
+			max = 4;
+		}
+		for (; n < max && s[n] >= '0' && s[n] <= '7'; n++)
+			c = c * 8 + s[n] - '0';
+	}
+	else
+	{
+		/* not an escape: the backslash stands for itself */
+		_write_buf(STDOUT_FILENO, "\\", 1);
+		return (0);
+	}
+	_putchar(c);
+	return (n);
+}
+
+/**
+ * put_escaped - queue a string, decoding backslash escapes
+ * @s: string
+ * @zero_octal: see put_escape()
+ * Return: 1 if a "\c" asked for the rest of the output to be dropped
+ */
+
+static int put_escaped(const char *s, int zero_octal)
+{
+	const char *p;
+	int stop = 0;
+
+	while (*s != '\0' && !stop)
+	{
+		p = strchr(s, '\\');
+		if (p == NULL)
+			p = s + strlen(s);
+		_write_buf(STDOUT_FILENO, s, p - s);
+		if (*p == '\0')
+			break;
+		s = p + 1;
+		s += put_escape(s, zero_octal, &stop);
+	}
+	return (stop);
+}
+
+/**
+ * echo_builtin - the "echo" builtin
+ * @args: argument vector
+ *
+ * Leading options are any mix of -n (no newline), -e (decode escapes)
+ * and -E (do not decode them); anything else is printed.
+ * Return: 0
+ */
+
+int echo_builtin(char **args)
+{
+	int newline = 1, escapes = 0, i;
+	char *opt;
+
+	for (args++; *args != NULL && (*args)[0] == '-' && (*args)[1] != '\0'; args++)
+	{
+		for (opt = *args + 1; *opt == 'n' || *opt == 'e' || *opt == 'E'; opt++)
+			;
+		if (*opt != '\0')
+			break;
+		for (opt = *args + 1; *opt != '\0'; opt++)
+		{
+			if (*opt == 'n')
+				newline = 0;
+			else
+				escapes = *opt == 'e';
+		}
+	}
+	for (i = 0; args[i] != NULL; i++)
+	{
+		if (i > 0)
+			_write_buf(STDOUT_FILENO, " ", 1);
+		if (!escapes)
+			_puts(args[i]);
+		else if (put_escaped(args[i], 1))
+			return (0);
+	}
+	if (newline)
+		_write_buf(STDOUT_FILENO, "\n", 1);
+	return (0);
+}
+
+/**
+ * printf_number - convert a printf argument to a number
+ * @arg: argument, or NULL when the arguments have run out
+ * @status: set to 1 if @arg is not a number
+ * Return: the value; a leading quote gives the code of the next byte
+ */
+
+static long printf_number(const char *arg, int *status)
+{
+	char *end;
+	long n;
+
+	if (arg == NULL || *arg == '\0')
+		return (0);
+	if (*arg == '\'' || *arg == '"')
+		return ((unsigned char)arg[1]);
+	errno = 0;
+	n = strtol(arg, &end, 0);
+	if (*end != '\0' || errno != 0)
+	{
+		_puts_fd(STDERR_FILENO, "printf: '");
+		_puts_fd(STDERR_FILENO, (char *)arg);
+		_puts_fd(STDERR_FILENO, "': invalid number\n");
+		*status = 1;
+	}
+	return (n);
+}
+
+/**
+ * printf_float - convert a printf argument to a floating-point number
+ * @arg: argument, or NULL when the arguments have run out
+ * @status: set to 1 if @arg is not a number
+ * Return: the value; a leading quote gives the code of the next byte
+ */
+
+static double printf_float(const char *arg, int *status)
+{
+	char *end;
+	double d;
+
+	if (arg == NULL || *arg == '\0')
+		return (0);
+	if (*arg == '\'' || *arg == '"')
+		return ((unsigned char)arg[1]);
+	errno = 0;
+	d = strtod(arg, &end);
+	if (*end != '\0' || errno != 0)
+	{
+		_puts_fd(STDERR_FILENO, "printf: '");
+		_puts_fd(STDERR_FILENO, (char *)arg);
+		_puts_fd(STDERR_FILENO, "': invalid number\n");
+		*status = 1;
+	}
+	return (d);
+}
+
+/**
+ * conv_format - snprintf one conversion
+ * @out: buffer
+ * @size: size of @out
+ * @spec: the conversion, see printf_conv()
+ * @arg: string argument
+ * @num: integer argument
+ * @fnum: floating-point argument
+ * Return: length of the full result, as snprintf
+ */
+
+static int conv_format(char *out, size_t size, const char *spec, const char *arg,
+		       long num, double fnum)
+{
+	char conv = spec[strlen(spec) - 1];
+
+	if (conv == 's')
+		return (snprintf(out, size, spec, arg));
+	if (conv == 'd' || conv == 'i')
+		return (snprintf(out, size, spec, num));
+	if (strchr("aAeEfFgG", conv) != NULL)
+		return (snprintf(out, size, spec, fnum));
+	return (snprintf(out, size, spec, (unsigned long)num));
+}
+
+/**
+ * printf_conv - print one conversion
+ * @spec: the conversion, "%" to the conversion letter, NUL-terminated;
+ * integer conversions carry an 'l'
+ * @arg: its argument, or NULL when the arguments have run out
+ * @status: set to 1 if @arg does not convert
+ * Return: 1 if a "\c" in a %b argument ended the output, otherwise 0
+ */
+
+static int printf_conv(char *spec, const char *arg, int *status)
+{
+	char buf[128], one[2], *out = buf, *conv = spec + strlen(spec) - 1;
+	double fnum = 0;
+	long num = 0;
+	int n;
+
+	if (*conv == 'b')
+		return (arg != NULL && put_escaped(arg, 1));
+	if (arg == NULL)
+		arg = "";
+	if (*conv == 'c')
+	{
+		/* the first byte as a string, so an empty argument prints nothing */
+		one[0] = *arg;
+		one[1] = '\0';
+		arg = one;
+		*conv = 's';
+	}
+	else if (strchr("aAeEfFgG", *conv) != NULL)
+	{
+		fnum = printf_float(arg, status);
+	}
+	else if (*conv != 's')
+	{
+		num = printf_number(arg, status);
+	}
+	n = conv_format(buf, sizeof(buf), spec, arg, num, fnum);
+	if (n >= (int)sizeof(buf))
+	{
+		out = malloc(n + 1);
+		if (out == NULL)
+		{
+			_perror("malloc");
+			*status = 1;
+			return (0);
+		}
+		conv_format(out, n + 1, spec, arg, num, fnum);
+	}
+	if (n > 0)
+		_write_buf(STDOUT_FILENO, out, n);
+	if (out != buf)
+		free(out);
+	return (0);
+}
+
+/**
+ * printf_format - print the format once
+ * @fmt: format
+ * @args: arguments, advanced past the ones used
+ * @status: set to 1 if something fails
+ * Return: 1 if the output was cut short by "\c" or an error, otherwise 0
+ */
+
+static int printf_format(const char *fmt, char ***args, int *status)
+{
+	char spec[64];
+	const char *p;
+	size_t n, len;
+	int stop = 0;
+
+	while (*fmt != '\0' && !stop)
+	{
+		for (p = fmt; *p != '\0' && *p != '%' && *p != '\\'; p++)
+			;
+		_write_buf(STDOUT_FILENO, fmt, p - fmt);
+		fmt = p;
+		if (*fmt == '\\')
+		{
+			fmt++;
+			fmt += put_escape(fmt, 0, &stop);
+			continue;
+		}
+		if (*fmt == '\0')
+			break;
+		if (fmt[1] == '%')
+		{
+			_write_buf(STDOUT_FILENO, "%", 1);
+			fmt += 2;
+			continue;
+		}
+		/* copy "%[flags][width][.precision]" and add 'l' for the integers */
+		n = 1 + strspn(fmt + 1, "-+ #0");
+		n += strspn(fmt + n, "0123456789");
+		if (fmt[n] == '.')
+			n += 1 + strspn(fmt + n + 1, "0123456789");
+		if (fmt[n] == '\0' || strchr("aAbcdeEfFgGiosuxX", fmt[n]) == NULL || n + 3 > sizeof(spec))
+		{
+			_puts_fd(STDERR_FILENO, "printf: ");
+			_write_buf(STDERR_FILENO, fmt, n + (fmt[n] != '\0'));
+			_puts_fd(STDERR_FILENO, ": invalid format\n");
+			*status = 1;
+			return (1);
+		}
+		memcpy(spec, fmt, n);
+		len = n;
+		if (strchr("diouxX", fmt[n]) != NULL)
+			spec[len++] = 'l';
+		spec[len++] = fmt[n];
+		spec[len] = '\0';
+		fmt += n + 1;
+		stop = printf_conv(spec, **args, status);
+		if (**args != NULL)
+			(*args)++;
+	}
+	return (stop);
+}
+
+/**
+ * printf_builtin - the "printf" builtin
+ * @args: argument vector: format, then arguments
+ *
+ * The format is reused while arguments remain, as POSIX asks.
+ * Return: 0 on success, 1 if an argument or the format is invalid
+ */
+
+int printf_builtin(char **args)
+{
+	char *fmt = args[1], **rest;
+	int status = 0;
+
+	if (fmt == NULL)
+	{
+		_puts_fd(STDERR_FILENO, "printf: usage: printf format [arguments]\n");
+		return (2);
+	}
+	args += 2;
+	do {
+		rest = args;
+		if (printf_format(fmt, &args, &status))
+			break;
+	} while (*args != NULL && args != rest);
+	return (status);
+}
@@ -0,0 +1,273 @@
+#include "shell.h"
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+/*
+ * Child reaping.  Every child the shell starts is tracked by a struct
+ * child; its pidfd is registered with one epoll instance, and a child is
+ * only ever reaped through wait4() on its own pid once its pidfd reports
+ * the exit.  Nothing calls a generic wait(), so a child can never be
+ * reaped on behalf of someone else, and the exit status and resource
+ * usage always land in the right struct.
+ *
+ * Kernels without pidfd_open fall back to a blocking wait4() per child.
+ */
+
+static int epoll_fd = -1;
+static int have_pidfd = 1;
+
+static int *pipestatus;
+static int pipestatus_cap;
+int pipestatus_count;
+
+/**
+ * child_exit_code - turn a wait status into a shell exit status
+ * @status: status from wait4
+ * Return: exit code, or 128 + signal number
+ */
+
+int child_exit_code(int status)
+{
+	if (WIFEXITED(status))
+		return (WEXITSTATUS(status));
+	return (128 + WTERMSIG(status));
+}
+
+/**
+ * pidfd_open_compat - pidfd_open(2), which glibc 2.36 may not wrap
+ * @pid: process id
+ * Return: pidfd, or -1 with errno set
+ */
+
+static int pidfd_open_compat(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+	return (syscall(SYS_pidfd_open, pid, 0));
+#else
+	(void)pid;
+	errno = ENOSYS;
+	return (-1);
+#endif
+}
+
+/**
+ * child_init - set up tracking for a stage that may or may not be a process
+ * @c: child
+ * @pid: process id, or -1 for a stage that ran inside the shell
+ * @status: exit status to record when @pid is -1
+ */
+
+void child_init(struct child *c, pid_t pid, int status)
+{
+	_memset((char *)c, 0, sizeof(*c));
+	c->pid = pid;
+	c->pidfd = -1;
+	c->done = pid <= 0;
+	c->status = status;
+}
+
+/**
+ * reap_register - start watching a child for its exit
+ * @c: child, initialised with child_init()
+ *
+ * @c must stay at the same address until it is done.
+ * Return: 0 on success, -1 if the child is waited for without a pidfd
+ */
+
+int reap_register(struct child *c)
+{
+	struct epoll_event ev;
+
+	if (c->done || !have_pidfd)
+		return (-1);
+	if (epoll_fd < 0)
+	{
+		epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd < 0)
+		{
+			have_pidfd = 0;
+			return (-1);
+		}
+	}
+
+	c->pidfd = pidfd_open_compat(c->pid);
+	if (c->pidfd < 0)
+	{
+		if (errno == ENOSYS)
+			have_pidfd = 0;
+		return (-1);
+	}
+	fcntl(c->pidfd, F_SETFD, FD_CLOEXEC);
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = c;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->pidfd, &ev) != 0)
+	{
+		close(c->pidfd);
+		c->pidfd = -1;
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * child_collect - reap a child whose exit has been reported
+ * @c: child
+ * @options: 0 to block, WNOHANG otherwise
+ * Return: 1 if the child was reaped, 0 otherwise
+ */
+
+static int child_collect(struct child *c, int options)
+{
+	int status;
+	pid_t r;
+
+	do {
+		r = wait4(c->pid, &status, options, &c->rusage);
+	} while (r < 0 && errno == EINTR);
+
+	if (r == 0)
+		return (0);
+	if (c->started != 0)
+		c->ended = clock_us();
+	if (r > 0)
+		c->status = child_exit_code(status);
+	else
+		c->status = 127;
+	if (c->pidfd >= 0)
+	{
+		if (epoll_fd >= 0)
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->pidfd, NULL);
+		close(c->pidfd);
+		c->pidfd = -1;
+	}
+	c->done = 1;
+	return (1);
+}
+
+/**
+ * reap_poll - process pending exits of registered children
+ * @timeout: epoll timeout in milliseconds, -1 to block
+ *
+ * Any registered child may be reaped here, including background jobs
+ * that finish while the shell waits for something else.
+ * Return: number of children reaped, or -1 if nothing is registered
+ */
+
+int reap_poll(int timeout)
+{
+	struct epoll_event events[16];
+	int n, i, reaped = 0;
+
+	if (epoll_fd < 0)
+		return (-1);
+	n = epoll_wait(epoll_fd, events, 16, timeout);
+	for (i = 0; i < n; i++)
+		reaped += child_collect(events[i].data.ptr, WNOHANG);
+	return (reaped);
+}
+
+/**
+ * reap_wait - wait until every child of a set is done
+ * @children: children
+ * @n: number of children
+ */
+
+void reap_wait(struct child *children, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!children[i].done && children[i].pidfd < 0)
+			child_collect(&children[i], 0);
+	}
+	for (i = 0; i < n; i++)
+	{
+		while (!children[i].done)
+		{
+			if (reap_poll(-1) < 0)
+				child_collect(&children[i], 0);
+		}
+	}
+}
+
+/**
+ * reap_detach - drop the parent's epoll instance in a forked subshell
+ *
+ * The instance is shared across fork, so a subshell that touched it would
+ * unregister the parent's children.  The subshell gets an instance of its
+ * own when it first starts a child.
+ */
+
+void reap_detach(void)
+{
+	if (epoll_fd >= 0)
+		close(epoll_fd);
+	epoll_fd = -1;
+}
+
+/**
+ * children_status - exit status of a finished pipeline
+ * @children: one entry per stage
+ * @n: number of stages
+ *
+ * With "set -o pipefail" the status is that of the rightmost stage that
+ * failed, otherwise that of the last stage.
+ * Return: the status
+ */
+
+int children_status(struct child *children, int n)
+{
+	int i;
+
+	if (shell_options[OPT_PIPEFAIL].value)
+	{
+		for (i = n - 1; i >= 0; i--)
+		{
+			if (children[i].status != 0)
+				return (children[i].status);
+		}
+	}
+	return (n > 0 ? children[n - 1].status : 0);
+}
+
+/**
+ * pipeline_status - compute $? and PIPESTATUS for finished stages
+ * @children: one entry per stage
+ * @n: number of stages
+ * Return: the pipeline's exit status, see children_status()
+ */
+
+int pipeline_status(struct child *children, int n)
+{
+	int i;
+	int *tmp;
+
+	if (n > pipestatus_cap)
+	{
+		tmp = realloc(pipestatus, n * sizeof(int));
+		if (tmp != NULL)
+		{
+			pipestatus = tmp;
+			pipestatus_cap = n;
+		}
+	}
+	pipestatus_count = n < pipestatus_cap ? n : pipestatus_cap;
+	for (i = 0; i < pipestatus_count; i++)
+		pipestatus[i] = children[i].status;
+	return (children_status(children, n));
+}
+
+/**
+ * pipestatus_get - status of one stage of the last foreground pipeline
+ * @i: stage index
+ * Return: the status, or -1 if there is no such stage
+ */
+
+int pipestatus_get(int i)
+{
+	if (i < 0 || i >= pipestatus_count)
+		return (-1);
+	return (pipestatus[i]);
+}
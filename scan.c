@@ -0,0 +1,185 @@
+#include "shell.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+/*
+ * Delimiter scanning for the tokenizer.  tok_scan() returns the first
+ * byte at or after its argument that is NUL, whitespace, '<', '>', '|',
+ * '&', ';', '"', '\\' or '$'; everything before it can be copied as part
+ * of a word.
+ *
+ * The vector versions only use aligned loads, so they never touch a page
+ * the string does not already extend into.  They may still read past the
+ * terminator within that block, which is why AddressSanitizer is told to
+ * leave them alone.  The implementation is picked
+ * on first use from what the CPU supports.
+ */
+
+static unsigned char special[256];
+
+static char *scan_select(const char *p);
+static char *(*scan_impl)(const char *p) = scan_select;
+
+/**
+ * scan_scalar - byte-at-a-time scanner, used where no vector unit is
+ * available
+ * @p: string
+ * Return: pointer to the first special byte
+ */
+
+static char *scan_scalar(const char *p)
+{
+	while (!special[(unsigned char)*p])
+		p++;
+	return ((char *)p);
+}
+
+#ifdef SCAN_X86
+
+/**
+ * special_mask_sse2 - bitmask of the special bytes in 16 bytes
+ * @v: bytes
+ * Return: one bit per byte, set where the byte is special
+ */
+
+__attribute__((target("sse2")))
+static unsigned int special_mask_sse2(__m128i v)
+{
+	__m128i m, ws;
+
+	m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('|')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('$')));
+	/* '\t' .. '\r': v - 9 <= 4, unsigned */
+	ws = _mm_sub_epi8(v, _mm_set1_epi8(9));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(ws, _mm_set1_epi8(4)), ws));
+	return ((unsigned int)_mm_movemask_epi8(m));
+}
+
+/**
+ * scan_sse2 - 16-bytes-at-a-time scanner
+ * @p: string
+ * Return: pointer to the first special byte
+ */
+
+__attribute__((target("sse2"), no_sanitize_address))
+static char *scan_sse2(const char *p)
+{
+	const char *blk = (const char *)((size_t)p & ~(size_t)15);
+	unsigned int mask;
+
+	mask = special_mask_sse2(_mm_load_si128((const __m128i *)blk));
+	mask >>= p - blk;
+	if (mask != 0)
+		return ((char *)p + __builtin_ctz(mask));
+
+	for (;;)
+	{
+		blk += 16;
+		mask = special_mask_sse2(_mm_load_si128((const __m128i *)blk));
+		if (mask != 0)
+			return ((char *)blk + __builtin_ctz(mask));
+	}
+}
+
+/**
+ * special_mask_avx2 - bitmask of the special bytes in 32 bytes
+ * @v: bytes
+ * Return: one bit per byte, set where the byte is special
+ */
+
+__attribute__((target("avx2")))
+static unsigned int special_mask_avx2(__m256i v)
+{
+	__m256i m, ws;
+
+	m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$')));
+	ws = _mm256_sub_epi8(v, _mm256_set1_epi8(9));
+	m = _mm256_or_si256(m,
+		_mm256_cmpeq_epi8(_mm256_min_epu8(ws, _mm256_set1_epi8(4)), ws));
+	return ((unsigned int)_mm256_movemask_epi8(m));
+}
+
+/**
+ * scan_avx2 - 32-bytes-at-a-time scanner
+ * @p: string
+ * Return: pointer to the first special byte
+ */
+
+__attribute__((target("avx2"), no_sanitize_address))
+static char *scan_avx2(const char *p)
+{
+	const char *blk = (const char *)((size_t)p & ~(size_t)31);
+	unsigned int mask;
+
+	mask = special_mask_avx2(_mm256_load_si256((const __m256i *)blk));
+	mask >>= p - blk;
+	if (mask != 0)
+		return ((char *)p + __builtin_ctz(mask));
+
+	for (;;)
+	{
+		blk += 32;
+		mask = special_mask_avx2(_mm256_load_si256((const __m256i *)blk));
+		if (mask != 0)
+			return ((char *)blk + __builtin_ctz(mask));
+	}
+}
+
+#endif
+
+/**
+ * scan_select - pick the best scanner for this CPU, then run it
+ * @p: string
+ * Return: pointer to the first special byte
+ */
+
+static char *scan_select(const char *p)
+{
+	const char *set = " \t\n\v\f\r<>|&;\"\\$";
+
+	special[0] = 1;
+	for (; *set != '\0'; set++)
+		special[(unsigned char)*set] = 1;
+
+	scan_impl = scan_scalar;
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		scan_impl = scan_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		scan_impl = scan_sse2;
+#endif
+	return (scan_impl(p));
+}
+
+/**
+ * tok_scan - find the next byte the tokenizer has to look at
+ * @p: NUL-terminated string
+ * Return: pointer to the first NUL, whitespace, '<', '>', '|', '&', ';',
+ * '"', '\\' or '$'
+ */
+
+char *tok_scan(const char *p)
+{
+	return (scan_impl(p));
+}
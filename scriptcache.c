@@ -0,0 +1,581 @@
+#include "shell.h"
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+/*
+ * Compiled-script cache, enabled by pointing HSH_CACHE_DIR at a
+ * directory.  The first run of a script parses every line up front and
+ * writes the result to "<dir>/<hash of the script's real path>.hshc";
+ * later runs map that file and execute it without tokenizing or parsing.
+ * Two paths that hash alike only make each other's file look stale.
+ *
+ * A cache file is a header followed by a stream of 32-bit words and a
+ * block of NUL-terminated strings.  Strings are referred to by their
+ * offset in the block, so the file holds no pointers and is used where
+ * it is mapped.  The header records the script's device, inode, size and
+ * modification time; if any of them differ the file is compiled again.
+ *
+ * Per line the word stream holds either
+ *	SC_LIST count { op flags pipesize pipesize-word ncmds
+ *		{ argc flags input output argv... }... }
+ * or
+ *	SC_ERROR message
+ * for a line that did not parse, whose message is printed when the line
+ * is reached.  Empty lines leave no record.
+ */
+
+#define SC_MAGIC "HSHC0004"
+#define SC_BYTE_ORDER 0x01020304U
+#define SC_NONE 0xffffffffU
+
+#define SC_LIST 0
+#define SC_ERROR 1
+
+#define SC_APPEND 0x1
+#define SC_BACKGROUND 0x2
+#define SC_TIMED 0x4
+#define SC_EXPAND 0x8
+
+struct sc_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t pad;
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	uint64_t mtime_sec;
+	uint64_t mtime_nsec;
+	uint32_t nwords;
+	uint32_t nstrings;
+};
+
+struct sc_buf {
+	char *data;
+	size_t len;
+	size_t cap;
+	int failed;
+};
+
+struct sc_reader {
+	const uint32_t *words;
+	size_t nwords;
+	size_t pos;
+	const char *strings;
+	size_t nstrings;
+};
+
+/**
+ * sc_append - append bytes to a growable buffer
+ * @b: buffer; once an allocation fails it stays failed and ignores
+ * further appends
+ * @p: bytes
+ * @n: number of bytes
+ * Return: offset of the bytes in @b
+ */
+
+static uint32_t sc_append(struct sc_buf *b, const void *p, size_t n)
+{
+	size_t off = b->len, cap;
+	char *tmp;
+
+	if (b->failed || b->len + n >= SC_NONE)
+	{
+		b->failed = 1;
+		return (0);
+	}
+	if (b->len + n > b->cap)
+	{
+		for (cap = b->cap ? b->cap * 2 : 4096; cap < b->len + n; cap *= 2)
+			;
+		tmp = realloc(b->data, cap);
+		if (tmp == NULL)
+		{
+			b->failed = 1;
+			return (0);
+		}
+		b->data = tmp;
+		b->cap = cap;
+	}
+	memcpy(b->data + off, p, n);
+	b->len += n;
+	return (off);
+}
+
+/**
+ * sc_word - append one word to the word stream
+ * @w: word stream
+ * @v: value
+ */
+
+static void sc_word(struct sc_buf *w, uint32_t v)
+{
+	sc_append(w, &v, sizeof(v));
+}
+
+/**
+ * sc_string - append a string to the string block and its offset to the
+ * word stream
+ * @w: word stream
+ * @s: string block
+ * @str: string, or NULL
+ */
+
+static void sc_string(struct sc_buf *w, struct sc_buf *s, const char *str)
+{
+	sc_word(w, str == NULL ? SC_NONE : sc_append(s, str, strlen(str) + 1));
+}
+
+/**
+ * sc_encode - append a parsed line
+ * @w: word stream
+ * @s: string block
+ * @list: the line's command list
+ */
+
+static void sc_encode(struct sc_buf *w, struct sc_buf *s, CommandList *list)
+{
+	Pipeline *p;
+	Command *c;
+	int i, j, k;
+
+	sc_word(w, SC_LIST);
+	sc_word(w, list->count);
+	for (i = 0; i < list->count; i++)
+	{
+		p = list->items[i].pipeline;
+		sc_word(w, list->items[i].op);
+		sc_word(w, (p->background ? SC_BACKGROUND : 0) |
+			(p->timed ? SC_TIMED : 0) | (p->expand ? SC_EXPAND : 0));
+		sc_word(w, p->pipe_size < 0 ? SC_NONE :
+			p->pipe_size > INT_MAX ? INT_MAX : (uint32_t)p->pipe_size);
+		sc_string(w, s, p->pipe_size_word);
+		sc_word(w, p->command_count);
+		for (j = 0; j < p->command_count; j++)
+		{
+			c = &p->commands[j];
+			sc_word(w, c->argc);
+			sc_word(w, (c->append ? SC_APPEND : 0) | (c->expand ? SC_EXPAND : 0));
+			sc_string(w, s, c->input_file);
+			sc_string(w, s, c->output_file);
+			for (k = 0; k < c->argc; k++)
+				sc_string(w, s, c->argv[k]);
+		}
+	}
+}
+
+/**
+ * sc_compile_line - parse one line and append its record
+ * @w: word stream
+ * @s: string block
+ * @line: NUL-terminated line, tokenized in place
+ */
+
+static void sc_compile_line(struct sc_buf *w, struct sc_buf *s, char *line)
+{
+	char errmsg[128];
+	CommandList *list = NULL;
+	CList tokens;
+
+	if (line[0] == '\0')
+		return;
+	arena_reset(&line_arena);
+	tokens = TOK_tokenize_input(&line_arena, line, errmsg, sizeof(errmsg));
+	if (tokens != NULL)
+		list = parse_tokens(&line_arena, tokens, errmsg, sizeof(errmsg));
+	if (list != NULL)
+	{
+		sc_encode(w, s, list);
+	}
+	else
+	{
+		sc_word(w, SC_ERROR);
+		sc_string(w, s, errmsg);
+	}
+}
+
+/**
+ * sc_compile - parse a whole script
+ * @fd: the script, open for reading
+ * @size: its size
+ * @w: receives the word stream
+ * @s: receives the string block
+ * Return: 0 on success, -1 on failure
+ */
+
+static int sc_compile(int fd, size_t size, struct sc_buf *w, struct sc_buf *s)
+{
+	char *map, *line, *end, *nl, *last;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return (-1);
+	madvise(map, size, MADV_SEQUENTIAL);
+	for (line = map, end = map + size; line < end; line = nl + 1)
+	{
+		nl = memchr(line, '\n', end - line);
+		if (nl == NULL)
+		{
+			last = malloc(end - line + 1);
+			if (last == NULL)
+			{
+				w->failed = 1;
+				break;
+			}
+			memcpy(last, line, end - line);
+			last[end - line] = '\0';
+			sc_compile_line(w, s, last);
+			free(last);
+			break;
+		}
+		*nl = '\0';
+		sc_compile_line(w, s, line);
+	}
+	munmap(map, size);
+	/* a final NUL keeps every string offset inside the block terminated */
+	sc_append(s, "", 1);
+	arena_reset(&line_arena);
+	return (w->failed || s->failed ? -1 : 0);
+}
+
+/**
+ * sc_next - read the next word
+ * @r: reader
+ * @v: receives the word
+ * Return: 0, or -1 at the end of the stream
+ */
+
+static int sc_next(struct sc_reader *r, uint32_t *v)
+{
+	if (r->pos >= r->nwords)
+		return (-1);
+	*v = r->words[r->pos++];
+	return (0);
+}
+
+/**
+ * sc_str - read a string reference
+ * @r: reader
+ * @str: receives the string, or NULL for none
+ * Return: 0, or -1 if the reference is out of range
+ */
+
+static int sc_str(struct sc_reader *r, char **str)
+{
+	uint32_t off;
+
+	if (sc_next(r, &off) != 0)
+		return (-1);
+	*str = NULL;
+	if (off == SC_NONE)
+		return (0);
+	if (off >= r->nstrings)
+		return (-1);
+	*str = (char *)r->strings + off;
+	return (0);
+}
+
+/**
+ * sc_decode_pipeline - rebuild one pipeline of a line
+ * @r: reader
+ * @list: list to add it to
+ * Return: 0, or -1 if the stream is malformed
+ */
+
+static int sc_decode_pipeline(struct sc_reader *r, CommandList *list)
+{
+	uint32_t op, flags, size, ncmds, argc, cflags, i, j;
+	char *in, *out, *size_word, *word;
+	Pipeline *p;
+
+	if (sc_next(r, &op) || sc_next(r, &flags) || sc_next(r, &size) ||
+	    sc_str(r, &size_word) || sc_next(r, &ncmds) || op > LIST_OR)
+		return (-1);
+	p = CommandList_add_pipeline(list, op);
+	p->background = (flags & SC_BACKGROUND) != 0;
+	p->timed = (flags & SC_TIMED) != 0;
+	p->expand = (flags & SC_EXPAND) != 0;
+	p->pipe_size = size == SC_NONE ? -1 : (long)size;
+	p->pipe_size_word = size_word;
+	for (i = 0; i < ncmds; i++)
+	{
+		if (sc_next(r, &argc) || sc_next(r, &cflags) ||
+		    sc_str(r, &in) || sc_str(r, &out) || argc == 0)
+			return (-1);
+		for (j = 0; j < argc; j++)
+		{
+			if (sc_str(r, &word) || word == NULL)
+				return (-1);
+			if (j == 0)
+				Pipeline_add_command(p, word);
+			else
+				Pipeline_add_argument(p, word);
+		}
+		p->commands[i].expand = (cflags & SC_EXPAND) != 0;
+		Pipeline_set_input_file(p, in);
+		if (out != NULL)
+			Pipeline_set_output_file(p, out, (cflags & SC_APPEND) != 0);
+	}
+	return (0);
+}
+
+/**
+ * sc_decode - rebuild the next line in line_arena
+ * @r: reader
+ * @list: receives the command list, or NULL for a line that did not parse
+ * @msg: receives the error message of a line that did not parse
+ *
+ * The strings stay in the cache image; only the structures are built.
+ * Return: 1 for a line, 0 at the end, -1 if the stream is malformed
+ */
+
+static int sc_decode(struct sc_reader *r, CommandList **list, char **msg)
+{
+	uint32_t kind, count, i;
+
+	*list = NULL;
+	*msg = NULL;
+	if (sc_next(r, &kind) != 0)
+		return (0);
+	if (kind == SC_ERROR)
+		return (sc_str(r, msg) || *msg == NULL ? -1 : 1);
+	if (kind != SC_LIST || sc_next(r, &count) != 0)
+		return (-1);
+	*list = CommandList_new(&line_arena);
+	for (i = 0; i < count; i++)
+	{
+		if (sc_decode_pipeline(r, *list) != 0)
+			return (-1);
+	}
+	return (1);
+}
+
+/**
+ * sc_valid - check that a whole image decodes
+ * @r: reader
+ * Return: 1 if it does, 0 otherwise
+ */
+
+static int sc_valid(struct sc_reader *r)
+{
+	CommandList *list;
+	char *msg;
+	int rc;
+
+	do {
+		arena_reset(&line_arena);
+		rc = sc_decode(r, &list, &msg);
+	} while (rc > 0);
+	arena_reset(&line_arena);
+	r->pos = 0;
+	return (rc == 0);
+}
+
+/**
+ * sc_execute - run every line of an image
+ * @r: reader
+ */
+
+static void sc_execute(struct sc_reader *r)
+{
+	CommandList *list;
+	char *msg;
+	long t0;
+
+	while (1)
+	{
+		arena_reset(&line_arena);
+		t0 = trace_begin();
+		if (sc_decode(r, &list, &msg) <= 0)
+			break;
+		if (list == NULL)
+		{
+			_puts_fd(STDERR_FILENO, msg);
+			last_status = 2;
+		}
+		else
+		{
+			execute_list(list, &line_arena, 0);
+		}
+		trace_end("line", NULL, t0);
+	}
+	arena_reset(&line_arena);
+}
+
+/**
+ * sc_header_init - fill in the header that a script's cache must carry
+ * @h: header
+ * @st: the script's status
+ */
+
+static void sc_header_init(struct sc_header *h, const struct stat *st)
+{
+	_memset((char *)h, 0, sizeof(*h));
+	memcpy(h->magic, SC_MAGIC, sizeof(h->magic));
+	h->byte_order = SC_BYTE_ORDER;
+	h->dev = st->st_dev;
+	h->ino = st->st_ino;
+	h->size = st->st_size;
+	h->mtime_sec = st->st_mtim.tv_sec;
+	h->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+/**
+ * sc_cache_path - name the cache file of a script
+ * @dir: cache directory
+ * @path: script path
+ * @buf: destination
+ * @size: size of @buf
+ * Return: 0, or -1 if the name does not fit
+ */
+
+static int sc_cache_path(const char *dir, const char *path, char *buf, size_t size)
+{
+	char *real = realpath(path, NULL);
+	const char *s = real ? real : path;
+	unsigned long h = 2166136261UL;
+	int n;
+
+	for (; *s != '\0'; s++)
+	{
+		h ^= (unsigned char)*s;
+		h = (h * 16777619UL) & 0xffffffffUL;
+	}
+	free(real);
+	n = snprintf(buf, size, "%s/%08lx.hshc", dir, h);
+	return (n > 0 && (size_t)n < size ? 0 : -1);
+}
+
+/**
+ * sc_run_cached - run a script from its cache file, if it is current
+ * @cache: cache file path
+ * @want: header the cache must carry
+ * Return: 0 if the script was run, -1 if the cache is missing or stale
+ */
+
+static int sc_run_cached(const char *cache, const struct sc_header *want)
+{
+	int fd = open(cache, O_RDONLY | O_CLOEXEC);
+	struct sc_header *h;
+	struct sc_reader r;
+	struct stat st;
+	char *map;
+	size_t size;
+	int ok;
+
+	if (fd < 0)
+		return (-1);
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*h))
+	{
+		close(fd);
+		return (-1);
+	}
+	size = st.st_size;
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return (-1);
+
+	h = (struct sc_header *)map;
+	r.words = (const uint32_t *)(map + sizeof(*h));
+	r.nwords = h->nwords;
+	r.pos = 0;
+	r.strings = (const char *)(r.words + r.nwords);
+	r.nstrings = h->nstrings;
+	ok = memcmp(h, want, offsetof(struct sc_header, nwords)) == 0 &&
+		sizeof(*h) + (size_t)h->nwords * sizeof(uint32_t) + h->nstrings == size &&
+		h->nstrings > 0 && r.strings[r.nstrings - 1] == '\0' && sc_valid(&r);
+	if (ok)
+		sc_execute(&r);
+	munmap(map, size);
+	return (ok ? 0 : -1);
+}
+
+/**
+ * sc_write - store a compiled script
+ * @cache: cache file path
+ * @h: header, with the counts filled in
+ * @w: word stream
+ * @s: string block
+ *
+ * The file is written under a temporary name and renamed into place, so
+ * a concurrent run sees either the old file or the complete new one.
+ */
+
+static void sc_write(const char *cache, struct sc_header *h, struct sc_buf *w,
+		     struct sc_buf *s)
+{
+	char tmp[PATH_MAX + 32];
+	struct iovec iov[3];
+	size_t total;
+	int fd;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", cache, (int)getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	iov[0].iov_base = h;
+	iov[0].iov_len = sizeof(*h);
+	iov[1].iov_base = w->data;
+	iov[1].iov_len = w->len;
+	iov[2].iov_base = s->data;
+	iov[2].iov_len = s->len;
+	total = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+	if (writev(fd, iov, 3) != (ssize_t)total || close(fd) != 0 ||
+	    rename(tmp, cache) != 0)
+		unlink(tmp);
+}
+
+/**
+ * scriptcache_run - run a script through the compiled-script cache
+ * @path: script path
+ * @fd: the script, open for reading
+ * @st: its status
+ *
+ * A missing or stale cache file is replaced after compiling the script;
+ * the script then runs from the freshly compiled image.
+ * Return: 0 if the script was run, -1 if it must be run the usual way
+ * (the cache is off, or compiling failed before any line ran)
+ */
+
+int scriptcache_run(const char *path, int fd, const struct stat *st)
+{
+	char *dir = var_get("HSH_CACHE_DIR"), cache[PATH_MAX];
+	struct sc_buf w, s;
+	struct sc_header h;
+	struct sc_reader r;
+	long t0;
+	int rc;
+
+	if (dir == NULL || *dir == '\0' || sc_cache_path(dir, path, cache, sizeof(cache)) != 0)
+		return (-1);
+	sc_header_init(&h, st);
+
+	t0 = trace_begin();
+	if (sc_run_cached(cache, &h) == 0)
+	{
+		trace_end("scriptcache", path, t0);
+		return (0);
+	}
+
+	_memset((char *)&w, 0, sizeof(w));
+	_memset((char *)&s, 0, sizeof(s));
+	rc = sc_compile(fd, st->st_size, &w, &s);
+	trace_end("compile", path, t0);
+	if (rc == 0)
+	{
+		h.nwords = w.len / sizeof(uint32_t);
+		h.nstrings = s.len;
+		if (mkdir(dir, 0755) == 0 || errno == EEXIST)
+			sc_write(cache, &h, &w, &s);
+		r.words = (const uint32_t *)w.data;
+		r.nwords = h.nwords;
+		r.pos = 0;
+		r.strings = s.data;
+		r.nstrings = s.len;
+		sc_execute(&r);
+	}
+	free(w.data);
+	free(s.data);
+	return (rc);
+}
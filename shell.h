@@ -1,6 +1,10 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -12,39 +16,219 @@
 #include <sys/stat.h>
 #include <signal.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/resource.h>
 
 #define SYMBOL_MAX_SIZE 31
+#define OUTBUF_SIZE 4096
+#define HASH_MIN_SIZE 32
+#define BATCH_BUF_SIZE 65536
+#define SUBST_READ_SIZE 65536
+
+#define EXEC_TAIL 0x1
+
+#define VAR_EXPORT 0x1
 
 typedef enum {
   TOK_WORD,
   TOK_QUOTED_WORD,
   TOK_LESSTHAN,
   TOK_GREATERTHAN,
+  TOK_APPEND,
   TOK_PIPE,
+  TOK_AMP,
+  TOK_SEMI,
+  TOK_AND_IF,
+  TOK_OR_IF,
   TOK_END
 } TokenType;
 
+#define TOKF_QUOTED 0x1
+#define TOKF_ESCAPED 0x2
+#define TOKF_EXPAND 0x4
+
 typedef struct {
   TokenType type;
   char *value;
+  size_t length;
+  unsigned int flags;
 } Token;
 
+struct outbuf {
+  int fd;
+  size_t len;
+  char data[OUTBUF_SIZE];
+};
+
+/* a growable byte buffer; not NUL-terminated unless the user adds one */
+struct strbuf {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+struct hash_entry {
+  char *name;
+  char *path;
+  int hits;
+};
+
+enum option_type {
+  OPT_BOOL,
+  OPT_INT,
+  OPT_SIZE,
+  OPT_CHOICE
+};
+
+enum option_id {
+  OPT_SPAWN,
+  OPT_PIPESIZE,
+  OPT_PIPEFAIL,
+  OPT_TRACE_TIMING,
+  OPT_TRACE_FD,
+  OPT_TRACE_FORMAT,
+  OPT_TIME_FORMAT,
+  OPT_LINECACHE
+};
+
+enum spawn_backend {
+  SPAWN_POSIX,
+  SPAWN_VFORK,
+  SPAWN_FORK
+};
+
+enum trace_format {
+  TRACE_CHROME,
+  TRACE_JSONL
+};
+
+enum time_format {
+  TIME_TEXT,
+  TIME_JSON
+};
+
+struct shell_option {
+  char *name;
+  char *env;
+  enum option_type type;
+  long value;
+  char **choices;
+};
+
+extern struct shell_option shell_options[];
+extern long pipe_size_effective;
+
+struct arena_chunk {
+  struct arena_chunk *next;
+  size_t size;
+  size_t used;
+};
+
+struct arena_stats {
+  unsigned long chunk_mallocs;
+  unsigned long line_mallocs;
+  unsigned long allocs;
+  unsigned long resets;
+  size_t reserved;
+  size_t bytes;
+  size_t high_water;
+};
+
+typedef struct _arena {
+  struct arena_chunk *head;
+  struct arena_chunk *cur;
+  size_t chunk_size;
+  struct arena_stats stats;
+} Arena;
+
+#define LINE_ARENA_CHUNK 16384
+
+extern Arena line_arena;
+extern int last_status;
+extern int interactive;
+
 typedef struct _clist *CList;
 
 typedef Token CListElementType;
 
+#define BI_SUBSHELL 0x1
+#define BI_PURE 0x2
+#define BI_JOBS 0x4
+#define BI_SYNTAX 0x8
+
+struct builtin {
+  char *name;
+  int (*handler)(char **args);
+  int flags;
+};
+
 typedef struct _command {
     char *name;   
-    CList args;  
+    char **argv;
+    int argc;
+    int argv_cap;
+    const struct builtin *builtin;
+    char *path;
+    unsigned long path_gen;
+    int expand;
+    char *input_file;
+    char *output_file;
+    int append;
 } Command;
 
+struct child {
+  pid_t pid;
+  int pidfd;
+  int status;
+  int done;
+  struct rusage rusage;
+  long started;
+  long ended;
+};
+
 typedef struct _pipeline {
     Command *commands;    
     int command_count;     
-    char *input_file;     
-    char *output_file;     
+    int command_cap;
+    long pipe_size;
+    char *pipe_size_word; /* PIPESIZE= value expanded at run time */
+    int background;
+    int timed;
+    int expand;
+    Arena *arena;
 } Pipeline;
 
+enum list_op {
+  LIST_SEQ,
+  LIST_AND,
+  LIST_OR
+};
+
+/*
+ * A command list: pipelines joined by ';', '&', '&&' and '||'.  op is the
+ * operator in front of the pipeline, LIST_SEQ for the first one.
+ */
+typedef struct _list_item {
+    Pipeline *pipeline;
+    enum list_op op;
+} ListItem;
+
+typedef struct _command_list {
+    ListItem *items;
+    int count;
+    int cap;
+    Arena *arena;
+} CommandList;
+
+struct job {
+  int id;
+  pid_t pgid;
+  int nchildren;
+  struct child *children;
+  char *text;
+};
+
 char *_strcpy(char *dest, char *src);
 int _strlen(char *s);
 void _puts(char *str);
@@ -55,16 +239,33 @@ char *_memset(char *s, char b, unsigned int n);
 char *_strdup(char *str);
 int _isspace(int c);
 
+ssize_t _write_buf(int fd, const char *buf, size_t n);
+void _puts_fd(int fd, char *str);
+void _perror(char *s);
+int _flush(int fd);
+void _flush_all(void);
+int strbuf_reserve(struct strbuf *sb, size_t n);
+int strbuf_put(struct strbuf *sb, const char *s, size_t n);
+struct strbuf *output_capture(struct strbuf *sb);
+
+void arena_init(Arena *a, size_t chunk_size);
+void *arena_alloc(Arena *a, size_t n);
+char *arena_strdup(Arena *a, const char *s);
+char *arena_strndup(Arena *a, const char *s, size_t n);
+void arena_reset(Arena *a);
+void arena_free(Arena *a);
+int memstats_builtin(char **args);
+
+char *tok_scan(const char *p);
 const char *TT_to_str(TokenType tt);
-CList TOK_tokenize_input(const char *input, char *errmsg, size_t errmsg_sz);
+CList TOK_tokenize_input(Arena *arena, char *input, char *errmsg, size_t errmsg_sz);
 TokenType TOK_next_type(CList tokens);
 Token TOK_next(CList tokens);
 void TOK_consume(CList tokens);
-void TOK_free_tokens(CList tokens);
 
 extern const CListElementType INVALID_RETURN;
 
-CList CL_new();
+CList CL_new(Arena *arena);
 void CL_free(CList list);
 int CL_length(CList list);
 void CL_push(CList list, CListElementType element);
@@ -78,17 +279,109 @@ void CL_reverse(CList list);
 typedef void (*CL_foreach_callback)(int pos, CListElementType element, void *cb_data);
 void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data);
 
-Pipeline *Pipeline_new();
-void Pipeline_free(Pipeline *pipeline);
-void Pipeline_set_input_file(Pipeline *pipeline, const char *filename);
-void Pipeline_set_output_file(Pipeline *pipeline, const char *filename);
-void Pipeline_add_command(Pipeline *pipeline, const char *command_name);
-void Pipeline_add_argument(Pipeline *pipeline, const char *argument);
-Pipeline *parse_tokens(CList tokens, char *errmsg, size_t errmsg_sz);
+Pipeline *Pipeline_new(Arena *arena);
+void Pipeline_set_input_file(Pipeline *pipeline, char *filename);
+void Pipeline_set_output_file(Pipeline *pipeline, char *filename, int append);
+void Pipeline_add_command(Pipeline *pipeline, char *command_name);
+void Pipeline_add_argument(Pipeline *pipeline, char *argument);
+void Pipeline_mark_expand(Pipeline *pipeline);
+CommandList *CommandList_new(Arena *arena);
+Pipeline *CommandList_add_pipeline(CommandList *list, enum list_op op);
+CommandList *parse_tokens(Arena *arena, CList tokens, char *errmsg, size_t errmsg_sz);
+
+char *find_command_in_path(char *cmd);
+extern unsigned long hash_generation;
+void hash_validate(void);
+void hash_clear(void);
+int hash_builtin(char **args);
+
+extern unsigned long var_generation;
+void vars_init(void);
+char *var_get(const char *name);
+char *var_getn(const char *name, size_t len);
+int var_set(const char *name, const char *value, int flags);
+int var_setn(const char *name, size_t len, const char *value, int flags);
+void var_unset(const char *name);
+char **var_environ(void);
+size_t var_name_len(const char *s);
+int var_is_assignment(const char *word);
+int assign_builtin(char **args);
+int export_builtin(char **args);
+int unset_builtin(char **args);
+
+int arith_eval(const char *s, size_t len, long *result);
+int let_builtin(char **args);
+int arith_command_builtin(char **args);
+
+int echo_builtin(char **args);
+int printf_builtin(char **args);
+int test_builtin(char **args);
+
+void options_init(void);
+void options_var_set(const char *name, size_t len, const char *value);
+int parse_size(const char *value, long *n);
+int set_builtin(char **args);
+
+const struct builtin *builtin_lookup(const char *name);
+const struct builtin *builtin_find(const char *name);
+
+pid_t spawn_command(char *path, char **argv, int in_fd, int out_fd, pid_t pgid);
+pid_t spawn_builtin(const struct builtin *bi, char **argv, int in_fd, int out_fd, pid_t pgid);
+void exec_command(char *path, char **argv, int in_fd, int out_fd);
+
+int child_exit_code(int status);
+void child_init(struct child *c, pid_t pid, int status);
+int reap_register(struct child *c);
+int reap_poll(int timeout);
+void reap_wait(struct child *children, int n);
+void reap_detach(void);
+int children_status(struct child *children, int n);
+int pipeline_status(struct child *children, int n);
+int pipestatus_get(int i);
+extern int pipestatus_count;
+
+extern pid_t last_background_pid;
+struct job *job_new(Pipeline *pipeline);
+void job_launched(struct job *job);
+void jobs_notify(void);
+void jobs_clear(void);
+void jobs_snapshot(void);
+int jobs_builtin(char **args);
+int wait_builtin(char **args);
+
+int parallel_builtin(char **args);
+
+long clock_us(void);
+long trace_begin(void);
+void trace_end(const char *name, const char *cmd, long t0);
+void trace_child(struct child *c, const char *cmd);
+size_t json_string(char *dst, size_t size, const char *s);
+
+void time_self_begin(struct rusage *before);
+void time_self_end(struct child *c, const struct rusage *before);
+void time_report(Pipeline *pipeline, struct child *children, long real);
+
+int stage_is_copy(Command *cmd);
+int copy_fd(int in, int out);
+int run_copy_stage(Command *cmd, int in_fd, int out_fd);
+
+void run_line(char *input, int flags);
+int run_fd(int fd);
+int run_script(const char *path);
+int run_string(char *s);
+int scriptcache_run(const char *path, int fd, const struct stat *st);
+
+char *expand_word(Arena *a, char *word);
+Pipeline *expand_pipeline(Pipeline *pipeline, Arena *a);
+int command_subst(const char *text, size_t len, Arena *a, struct strbuf *out);
+
+void execute_pipeline(Pipeline *pipeline, Arena *scratch, int flags);
+void execute_list(CommandList *list, Arena *scratch, int flags);
 
-void execute_pipeline(Pipeline *pipeline);
+struct line_entry;
+CommandList *linecache_lookup(const char *line, size_t len, struct line_entry **miss);
+void linecache_insert(struct line_entry *e, CommandList *list);
+int linecache_builtin(char **args);
 void execute_command(char *cmd, char **args);
-int is_builtin_command(char *cmd);
-void handle_builtin_command(char *cmd, char **args);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "shell.h"
+#include <spawn.h>
+
+/*
+ * Process launch backends, selected with "set -o spawn=...".
+ *
+ * posix_spawn and vfork share the parent's address space until the child
+ * calls execve, so launch cost does not grow with the size of the shell's
+ * heap.  Plain fork is kept for children that must run shell code rather
+ * than exec a program.
+ */
+
+/**
+ * spawn_posix - launch a program with posix_spawn
+ * @path: program to execute
+ * @argv: argument vector
+ * @in_fd: descriptor to use as stdin
+ * @out_fd: descriptor to use as stdout
+ * @pgid: process group for the child, see spawn_command()
+ * @envp: environment
+ * Return: pid of the child, or -1 with errno set
+ */
+
+static pid_t spawn_posix(char *path, char **argv, int in_fd, int out_fd, pid_t pgid,
+			 char **envp)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	pid_t pid;
+	int err;
+
+	err = posix_spawn_file_actions_init(&actions);
+	if (err != 0)
+	{
+		errno = err;
+		return (-1);
+	}
+	if (in_fd != STDIN_FILENO)
+		posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+	if (out_fd != STDOUT_FILENO)
+		posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+	posix_spawnattr_init(&attr);
+	if (pgid >= 0)
+	{
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+		posix_spawnattr_setpgroup(&attr, pgid);
+	}
+
+	err = posix_spawn(&pid, path, &actions, &attr, argv, envp);
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	if (err != 0)
+	{
+		errno = err;
+		return (-1);
+	}
+	return (pid);
+}
+
+/**
+ * child_exec - set up stdio and exec in a vfork or fork child
+ * @path: program to execute
+ * @argv: argument vector
+ * @in_fd: descriptor to use as stdin
+ * @out_fd: descriptor to use as stdout
+ * @pgid: process group for the child, see spawn_command()
+ * @envp: environment, built by the parent
+ *
+ * Only async-signal-safe calls are made here: after vfork the child still
+ * runs on the parent's memory.
+ */
+
+static void child_exec(char *path, char **argv, int in_fd, int out_fd, pid_t pgid,
+		       char **envp)
+{
+	char *msg;
+
+	if (pgid >= 0)
+		setpgid(0, pgid);
+	if (in_fd != STDIN_FILENO)
+		dup2(in_fd, STDIN_FILENO);
+	if (out_fd != STDOUT_FILENO)
+		dup2(out_fd, STDOUT_FILENO);
+	execve(path, argv, envp);
+
+	msg = errno == ENOENT ? ": not found\n" : ": cannot execute\n";
+	if (write(STDERR_FILENO, argv[0], _strlen(argv[0])) > 0)
+		write(STDERR_FILENO, msg, _strlen(msg));
+	_exit(errno == ENOENT ? 127 : 126);
+}
+
+/**
+ * spawn_command - start a program with the configured backend
+ * @path: program to execute
+ * @argv: argument vector
+ * @in_fd: descriptor to use as stdin
+ * @out_fd: descriptor to use as stdout
+ * @pgid: process group to put the child in: 0 to start a new group led by
+ * the child, -1 to leave it in the shell's group
+ *
+ * Pipe descriptors are expected to be close-on-exec; only the copies made
+ * on stdin and stdout survive in the child.  The child gets the exported
+ * shell variables as its environment.
+ * Return: pid of the child, or -1 on failure
+ */
+
+pid_t spawn_command(char *path, char **argv, int in_fd, int out_fd, pid_t pgid)
+{
+	char **envp = var_environ();
+	pid_t pid;
+
+	_flush_all();
+	switch (shell_options[OPT_SPAWN].value)
+	{
+	case SPAWN_POSIX:
+		pid = spawn_posix(path, argv, in_fd, out_fd, pgid, envp);
+		if (pid < 0)
+			_perror(argv[0]);
+		return (pid);
+	case SPAWN_VFORK:
+		pid = vfork();
+		break;
+	default:
+		pid = fork();
+		break;
+	}
+
+	if (pid == 0)
+		child_exec(path, argv, in_fd, out_fd, pgid, envp);
+	if (pid < 0)
+		_perror("fork");
+	else if (pgid >= 0)
+		setpgid(pid, pgid);
+	return (pid);
+}
+
+/**
+ * spawn_builtin - run a builtin in a forked subshell
+ * @bi: builtin
+ * @argv: argument vector
+ * @in_fd: descriptor to use as stdin
+ * @out_fd: descriptor to use as stdout
+ * @pgid: process group for the child, see spawn_command()
+ *
+ * Used for builtins that are one stage of a multi-stage pipeline or of a
+ * background job; this is the one place where a full fork is still
+ * required.
+ * Return: pid of the child, or -1 on failure
+ */
+
+pid_t spawn_builtin(const struct builtin *bi, char **argv, int in_fd, int out_fd, pid_t pgid)
+{
+	pid_t pid;
+
+	if (bi->flags & BI_JOBS)
+		reap_poll(0);
+	_flush_all();
+	pid = fork();
+	if (pid < 0)
+	{
+		_perror("fork");
+		return (-1);
+	}
+	if (pgid >= 0)
+		setpgid(pid == 0 ? 0 : pid, pgid);
+	if (pid == 0)
+	{
+		reap_detach();
+		if (bi->flags & BI_JOBS)
+			jobs_snapshot();
+		else
+			jobs_clear();
+		if (in_fd != STDIN_FILENO)
+			dup2(in_fd, STDIN_FILENO);
+		if (out_fd != STDOUT_FILENO)
+			dup2(out_fd, STDOUT_FILENO);
+		/* no exec to drop the other pipe ends, which would keep readers from EOF */
+		close_range(3, ~0U, 0);
+		exit(bi->handler(argv));
+	}
+	return (pid);
+}
+
+/**
+ * exec_command - replace the shell with a program
+ * @path: program to execute
+ * @argv: argument vector
+ * @in_fd: descriptor to use as stdin
+ * @out_fd: descriptor to use as stdout
+ *
+ * Used for the last command of a -c string, where there is nothing left
+ * for the shell to do after the program exits.
+ */
+
+void exec_command(char *path, char **argv, int in_fd, int out_fd)
+{
+	_flush_all();
+	if (in_fd != STDIN_FILENO)
+		dup2(in_fd, STDIN_FILENO);
+	if (out_fd != STDOUT_FILENO)
+		dup2(out_fd, STDOUT_FILENO);
+	execve(path, argv, var_environ());
+	_puts_fd(STDERR_FILENO, argv[0]);
+	_puts_fd(STDERR_FILENO, errno == ENOENT ? ": not found\n" : ": cannot execute\n");
+	exit(errno == ENOENT ? 127 : 126);
+}
@@ -1,8 +1,14 @@
 #include "shell.h"
 
+/**
+ * _putchar - prints a character to stdout
+ * @c: character
+ * Return: 1 on success, -1 on error
+ */
+
 int _putchar(char c)
 {
-	return (write(1, &c, 1));
+	return (_write_buf(STDOUT_FILENO, &c, 1));
 }
 /**
  * _puts - prints a string
@@ -12,12 +18,7 @@ int _putchar(char c)
 
 void _puts(char *str)
 {
-	while (*str != '\0')
-	{
-		_putchar(*str);
-		str++;
-	}
-	/*_putchar('\n');*/
+	_puts_fd(STDOUT_FILENO, str);
 }
 
 /**
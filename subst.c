@@ -0,0 +1,146 @@
+#include "shell.h"
+
+/*
+ * Command substitution.  The text between "$(" and ")" is tokenized,
+ * parsed and run through execute_list like a line of its own, and what it
+ * writes to stdout becomes part of the word.
+ *
+ * A list made only of BI_PURE builtins, such as "$(pwd)", runs in the
+ * shell process with stdout captured into memory: no pipe and no fork.
+ * Anything else runs in a forked subshell whose stdout is a pipe; the
+ * last pipeline is executed in place of the subshell, so "$(date)" costs
+ * a single process.  The pipe is drained with large reads straight into
+ * the output buffer, and trailing newlines are dropped by shortening it.
+ */
+
+/**
+ * subst_in_shell - tell whether a list can run in the shell process
+ * @list: parsed command list
+ * Return: 1 if every pipeline is a single BI_PURE builtin writing to
+ * stdout, 0 otherwise
+ */
+
+static int subst_in_shell(CommandList *list)
+{
+	Pipeline *pl;
+	Command *cmd;
+	int i;
+
+	for (i = 0; i < list->count; i++)
+	{
+		pl = list->items[i].pipeline;
+		if (pl->command_count == 0)
+			continue;
+		if (pl->command_count != 1 || pl->background || pl->commands[0].output_file != NULL)
+			return (0);
+		cmd = &pl->commands[0];
+		/* an expanded command name may turn out not to be a builtin */
+		if (cmd->builtin == NULL || !(cmd->builtin->flags & BI_PURE) ||
+		    strpbrk(cmd->argv[0], "$\\") != NULL)
+			return (0);
+	}
+	return (1);
+}
+
+/**
+ * subst_fork - run a list in a subshell and read its output
+ * @list: parsed command list
+ * @a: scratch arena
+ * @out: buffer the output is appended to
+ * Return: 0, or -1 on failure
+ */
+
+static int subst_fork(CommandList *list, Arena *a, struct strbuf *out)
+{
+	struct child c;
+	int fds[2];
+	ssize_t n;
+	pid_t pid;
+
+	if (pipe2(fds, O_CLOEXEC) < 0)
+	{
+		_perror("pipe");
+		return (-1);
+	}
+	_flush_all();
+	pid = fork();
+	if (pid < 0)
+	{
+		_perror("fork");
+		close(fds[0]);
+		close(fds[1]);
+		return (-1);
+	}
+	if (pid == 0)
+	{
+		output_capture(NULL);
+		reap_detach();
+		jobs_clear();
+		dup2(fds[1], STDOUT_FILENO);
+		execute_list(list, a, EXEC_TAIL);
+		_flush_all();
+		exit(last_status);
+	}
+
+	close(fds[1]);
+	child_init(&c, pid, 0);
+	reap_register(&c);
+	while (strbuf_reserve(out, SUBST_READ_SIZE) == 0)
+	{
+		n = read(fds[0], out->data + out->len, out->cap - out->len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		out->len += n;
+	}
+	close(fds[0]);
+	reap_wait(&c, 1);
+	last_status = c.status;
+	return (0);
+}
+
+/**
+ * command_subst - run a command substitution
+ * @text: the command, not necessarily terminated
+ * @len: length of @text
+ * @a: arena for the parsed command
+ * @out: buffer the output is appended to, less its trailing newlines
+ *
+ * $? is left with the status of the command.
+ * Return: 0, or -1 on failure, which has been reported
+ */
+
+int command_subst(const char *text, size_t len, Arena *a, struct strbuf *out)
+{
+	struct strbuf *prev;
+	CommandList *list;
+	CList tokens;
+	char errmsg[128];
+	size_t start = out->len;
+	int ret = 0;
+
+	/* the tokenizer works in place */
+	tokens = TOK_tokenize_input(a, arena_strndup(a, text, len), errmsg, sizeof(errmsg));
+	list = tokens ? parse_tokens(a, tokens, errmsg, sizeof(errmsg)) : NULL;
+	if (list == NULL)
+	{
+		_puts_fd(STDERR_FILENO, errmsg);
+		last_status = 2;
+		return (-1);
+	}
+
+	if (subst_in_shell(list))
+	{
+		prev = output_capture(out);
+		execute_list(list, a, 0);
+		output_capture(prev);
+	}
+	else
+	{
+		ret = subst_fork(list, a, out);
+	}
+	while (out->len > start && out->data[out->len - 1] == '\n')
+		out->len--;
+	return (ret);
+}
@@ -0,0 +1,340 @@
+#include "shell.h"
+
+/*
+ * The "test" and "[" builtins.  Expressions are parsed by recursive
+ * descent over the arguments:
+ *
+ *	expr	:= and { -o and }
+ *	and	:= not { -a not }
+ *	not	:= ! not | primary
+ *	primary	:= ( expr ) | unary-op word | word binary-op word | word
+ *
+ * A word followed by a binary operator is always a comparison, so that
+ * "test ! = x" and "test -n = -n" mean what POSIX says they mean.
+ */
+
+struct test_state {
+	char **args;
+	int argc;
+	int pos;
+	int error;
+};
+
+static int test_expr(struct test_state *ts);
+
+/**
+ * test_error - report a malformed expression
+ * @ts: parser state
+ * @what: offending word, or NULL
+ * @msg: message
+ * Return: 0
+ */
+
+static int test_error(struct test_state *ts, const char *what, const char *msg)
+{
+	if (!ts->error)
+	{
+		_puts_fd(STDERR_FILENO, "test: ");
+		if (what != NULL)
+		{
+			_puts_fd(STDERR_FILENO, (char *)what);
+			_puts_fd(STDERR_FILENO, ": ");
+		}
+		_puts_fd(STDERR_FILENO, (char *)msg);
+		_puts_fd(STDERR_FILENO, "\n");
+	}
+	ts->error = 1;
+	return (0);
+}
+
+/**
+ * test_integer - convert an operand of an integer comparison
+ * @ts: parser state
+ * @s: operand
+ * @n: receives the value
+ * Return: 1 on success, 0 if @s is not an integer
+ */
+
+static int test_integer(struct test_state *ts, const char *s, long *n)
+{
+	char *end;
+
+	while (_isspace((unsigned char)*s))
+		s++;
+	errno = 0;
+	*n = strtol(s, &end, 10);
+	while (_isspace((unsigned char)*end))
+		end++;
+	if (end == s || *end != '\0' || errno != 0)
+		return (test_error(ts, s, "integer expression expected"));
+	return (1);
+}
+
+/**
+ * test_binary_op - tell whether a word is a binary operator
+ * @s: word
+ * Return: 1 if it is, 0 otherwise
+ */
+
+static int test_binary_op(const char *s)
+{
+	static const char * const ops[] = {
+		"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+		"-nt", "-ot", "-ef"
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+	{
+		if (strcmp(s, ops[i]) == 0)
+			return (1);
+	}
+	return (0);
+}
+
+/**
+ * test_binary - evaluate a binary operator
+ * @ts: parser state
+ * @a: left operand
+ * @op: operator
+ * @b: right operand
+ * Return: 1 if true, 0 if false
+ */
+
+static int test_binary(struct test_state *ts, const char *a, const char *op, const char *b)
+{
+	struct stat sa, sb;
+	long x, y;
+	int ok_a, ok_b;
+
+	if (op[0] != '-')
+	{
+		if (op[0] == '!')
+			return (strcmp(a, b) != 0);
+		if (op[0] == '<')
+			return (strcmp(a, b) < 0);
+		if (op[0] == '>')
+			return (strcmp(a, b) > 0);
+		return (strcmp(a, b) == 0);
+	}
+	if (op[1] == 'n' || op[1] == 'o' || (op[1] == 'e' && op[2] == 'f'))
+	{
+		ok_a = stat(a, &sa) == 0;
+		ok_b = stat(b, &sb) == 0;
+		if (op[1] == 'e')
+			return (ok_a && ok_b && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino);
+		if (op[1] == 'o')
+			return (ok_b && (!ok_a || sa.st_mtime < sb.st_mtime));
+		return (ok_a && (!ok_b || sa.st_mtime > sb.st_mtime));
+	}
+	if (!test_integer(ts, a, &x) || !test_integer(ts, b, &y))
+		return (0);
+	if (strcmp(op, "-eq") == 0)
+		return (x == y);
+	if (strcmp(op, "-ne") == 0)
+		return (x != y);
+	if (strcmp(op, "-lt") == 0)
+		return (x < y);
+	if (strcmp(op, "-le") == 0)
+		return (x <= y);
+	if (strcmp(op, "-gt") == 0)
+		return (x > y);
+	return (x >= y);
+}
+
+/**
+ * test_unary - evaluate a unary operator
+ * @op: operator letter
+ * @s: operand
+ * Return: 1 if true, 0 if false, -1 if @op is not a unary operator
+ */
+
+static int test_unary(char op, const char *s)
+{
+	struct stat st;
+	long fd;
+
+	switch (op)
+	{
+	case 'n':
+		return (*s != '\0');
+	case 'z':
+		return (*s == '\0');
+	case 'r':
+		return (access(s, R_OK) == 0);
+	case 'w':
+		return (access(s, W_OK) == 0);
+	case 'x':
+		return (access(s, X_OK) == 0);
+	case 't':
+		fd = strtol(s, NULL, 10);
+		return (fd >= 0 && fd <= INT_MAX && isatty((int)fd));
+	case 'h':
+	case 'L':
+		return (lstat(s, &st) == 0 && S_ISLNK(st.st_mode));
+	case 'e': case 'f': case 'd': case 's': case 'b': case 'c': case 'p':
+	case 'S': case 'g': case 'u': case 'k':
+		break;
+	default:
+		return (-1);
+	}
+	if (stat(s, &st) != 0)
+		return (0);
+	switch (op)
+	{
+	case 'f':
+		return (S_ISREG(st.st_mode));
+	case 'd':
+		return (S_ISDIR(st.st_mode));
+	case 's':
+		return (st.st_size > 0);
+	case 'b':
+		return (S_ISBLK(st.st_mode));
+	case 'c':
+		return (S_ISCHR(st.st_mode));
+	case 'p':
+		return (S_ISFIFO(st.st_mode));
+	case 'S':
+		return (S_ISSOCK(st.st_mode));
+	case 'g':
+		return ((st.st_mode & S_ISGID) != 0);
+	case 'u':
+		return ((st.st_mode & S_ISUID) != 0);
+	case 'k':
+		return ((st.st_mode & S_ISVTX) != 0);
+	default:
+		return (1);
+	}
+}
+
+/**
+ * test_primary - a parenthesised expression, an operator or a word
+ * @ts: parser state
+ * Return: 1 if true, 0 if false
+ */
+
+static int test_primary(struct test_state *ts)
+{
+	char **a = ts->args + ts->pos;
+	int left = ts->argc - ts->pos, r;
+
+	if (left <= 0)
+		return (test_error(ts, NULL, "argument expected"));
+	if (left >= 3 && test_binary_op(a[1]))
+	{
+		ts->pos += 3;
+		return (test_binary(ts, a[0], a[1], a[2]));
+	}
+	if (left >= 2 && a[0][0] == '-' && a[0][1] != '\0' && a[0][2] == '\0')
+	{
+		r = test_unary(a[0][1], a[1]);
+		if (r >= 0)
+		{
+			ts->pos += 2;
+			return (r);
+		}
+	}
+	if (strcmp(a[0], "(") == 0 && left >= 2)
+	{
+		ts->pos++;
+		r = test_expr(ts);
+		if (ts->pos >= ts->argc || strcmp(ts->args[ts->pos], ")") != 0)
+			return (test_error(ts, NULL, "')' expected"));
+		ts->pos++;
+		return (r);
+	}
+	if (left >= 2 && a[0][0] == '-' && a[0][1] != '\0' && a[0][2] == '\0' &&
+	    strcmp(a[0], "-a") != 0 && strcmp(a[0], "-o") != 0)
+		return (test_error(ts, a[0], "unary operator expected"));
+	ts->pos++;
+	return (a[0][0] != '\0');
+}
+
+/**
+ * test_not - the "!" operator
+ * @ts: parser state
+ * Return: 1 if true, 0 if false
+ */
+
+static int test_not(struct test_state *ts)
+{
+	int left = ts->argc - ts->pos;
+
+	if (left >= 2 && strcmp(ts->args[ts->pos], "!") == 0 &&
+	    !(left >= 3 && test_binary_op(ts->args[ts->pos + 1])))
+	{
+		ts->pos++;
+		return (!test_not(ts));
+	}
+	return (test_primary(ts));
+}
+
+/**
+ * test_and - the "-a" operator
+ * @ts: parser state
+ * Return: 1 if true, 0 if false
+ */
+
+static int test_and(struct test_state *ts)
+{
+	int r = test_not(ts);
+
+	while (ts->pos < ts->argc && strcmp(ts->args[ts->pos], "-a") == 0)
+	{
+		ts->pos++;
+		r = test_not(ts) && r;
+	}
+	return (r);
+}
+
+/**
+ * test_expr - the "-o" operator
+ * @ts: parser state
+ * Return: 1 if true, 0 if false
+ */
+
+static int test_expr(struct test_state *ts)
+{
+	int r = test_and(ts);
+
+	while (ts->pos < ts->argc && strcmp(ts->args[ts->pos], "-o") == 0)
+	{
+		ts->pos++;
+		r = test_and(ts) || r;
+	}
+	return (r);
+}
+
+/**
+ * test_builtin - the "test" and "[" builtins
+ * @args: argument vector; "[" needs a final "]"
+ * Return: 0 if the expression is true, 1 if it is false, 2 if it is
+ * malformed
+ */
+
+int test_builtin(char **args)
+{
+	struct test_state ts;
+	int r;
+
+	ts.args = args + 1;
+	ts.pos = 0;
+	ts.error = 0;
+	for (ts.argc = 0; ts.args[ts.argc] != NULL; ts.argc++)
+		;
+	if (strcmp(args[0], "[") == 0)
+	{
+		if (ts.argc == 0 || strcmp(ts.args[ts.argc - 1], "]") != 0)
+		{
+			_puts_fd(STDERR_FILENO, "[: missing ']'\n");
+			return (2);
+		}
+		ts.argc--;
+	}
+	if (ts.argc == 0)
+		return (1);
+	r = test_expr(&ts);
+	if (!ts.error && ts.pos < ts.argc)
+		test_error(&ts, ts.args[ts.pos], "unexpected argument");
+	return (ts.error ? 2 : !r);
+}
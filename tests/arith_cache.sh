@@ -0,0 +1,29 @@
+#!/bin/sh
+# Regression test: emptying the arithmetic cache while a variable's value
+# is being evaluated used to free the expression that referred to it.
+# Fill the cache to one short of its limit, then evaluate an expression
+# whose variable holds another expression.
+#
+# Usage: tests/arith_cache.sh [path-to-hsh]
+
+HSH=${1:-./hsh}
+script=$(mktemp) || exit 1
+trap 'rm -f "$script"' EXIT
+
+i=0
+while [ $i -lt 255 ]; do
+	echo "x=\$(( $i + 0 ))" >> "$script"
+	i=$((i + 1))
+done
+cat >> "$script" <<'END'
+a=q+1
+q=1
+echo $((a+q+q+q))
+END
+
+out=$("$HSH" "$script" 2>&1)
+if [ "$out" != "5" ]; then
+	echo "arith_cache: expected 5, got: $out"
+	exit 1
+fi
+echo "arith_cache: ok"
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Regression test: a command name that only becomes "name=value" or
+# "((...))" through expansion is looked up as a command; it used to be
+# run as an assignment or an arithmetic command.
+#
+# Usage: tests/assign_expand.sh [path-to-hsh]
+
+HSH=${1:-./hsh}
+
+out=$(printf 'X=Y=1\n$X\necho "$? [$Y]"\nA=((1))\n$A\necho $?\nv=5\nZ=$v\necho $Z\n' |
+	"$HSH" 2> /dev/null | tr '\n' ' ')
+if [ "$out" != "127 [] 127 5 " ]; then
+	echo "assign_expand: expected '127 [] 127 5 ', got: '$out'"
+	exit 1
+fi
+echo "assign_expand: ok"
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Regression test: "jobs" used to run in the shell ahead of the stages
+# after it, so "jobs | cmd" blocked forever once the listing outgrew the
+# pipe buffer.  The subshell's snapshot must also leave the shell's own
+# table alone.
+#
+# Usage: tests/jobs_pipe.sh [path-to-hsh]
+
+HSH=${1:-./hsh}
+script=$(mktemp) || exit 1
+trap 'rm -f "$script"' EXIT
+
+word=$(printf '%0100d' 0)
+i=0
+while [ $i -lt 1000 ]; do
+	echo "true $word &" >> "$script"
+	i=$((i + 1))
+done
+cat >> "$script" <<'END'
+sleep 0.3
+jobs | wc -l
+jobs | wc -l
+END
+
+out=$(timeout 20 "$HSH" "$script" 2>&1 | tr -d ' ' | tr '\n' ' ')
+if [ "$out" != "1000 1000 " ]; then
+	echo "jobs_pipe: expected '1000 1000 ', got: '$out'"
+	exit 1
+fi
+echo "jobs_pipe: ok"
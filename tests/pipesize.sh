@@ -0,0 +1,37 @@
+#!/bin/sh
+# Check that assigning PIPESIZE sets "set -o pipesize", and with -b
+# measure the throughput of a three-stage pipeline for several pipe
+# buffer sizes.
+#
+# Usage: tests/pipesize.sh [-b] [path-to-hsh]
+
+bench=0
+if [ "$1" = -b ]; then
+	bench=1
+	shift
+fi
+HSH=${1:-./hsh}
+
+out=$(printf 'PIPESIZE=1M\nset -o\n' | "$HSH" 2>&1 | grep '^pipesize')
+case "$out" in
+pipesize*1048576*) ;;
+*)
+	echo "pipesize: expected 1048576 after PIPESIZE=1M, got: $out"
+	exit 1
+	;;
+esac
+echo "pipesize: ok"
+[ $bench = 1 ] || exit 0
+
+mb=1024
+for size in 4K 16K 64K 256K 1M; do
+	best=
+	for run in 1 2 3; do
+		start=$(date +%s%N)
+		"$HSH" -c "PIPESIZE=$size head -c ${mb}M /dev/zero | tr '\\0' a | wc -c" > /dev/null
+		end=$(date +%s%N)
+		ms=$(( (end - start) / 1000000 ))
+		[ -z "$best" ] || [ $ms -lt $best ] && best=$ms
+	done
+	echo "pipesize $size: ${best} ms, $(( mb * 1000 / (best + 1) )) MiB/s"
+done
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Regression test: redirections apply to the stage they are written on.
+# They used to be kept per pipeline, so "echo X | cat < f" printed X and
+# "a > f | b" sent b's output to f.
+#
+# Usage: tests/redirect.sh [path-to-hsh]
+
+HSH=${1:-./hsh}
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+printf 'FILE\n' > "$dir/in"
+cat > "$dir/script" <<END
+echo X | cat < $dir/in
+echo A > $dir/a | tr a-z A-Z
+cat $dir/a
+< $dir/in cat | tr A-Z a-z
+echo B | cat >> $dir/a
+cat $dir/a
+END
+
+out=$("$HSH" "$dir/script" 2>&1)
+expected="FILE
+A
+file
+A
+B"
+if [ "$out" != "$expected" ]; then
+	echo "redirect: expected:"
+	echo "$expected"
+	echo "redirect: got:"
+	echo "$out"
+	exit 1
+fi
+echo "redirect: ok"
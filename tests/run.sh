@@ -0,0 +1,18 @@
+#!/bin/sh
+# Build the shell and run every test in this directory.
+# Usage: tests/run.sh   (from the top of the tree)
+
+CFLAGS=${CFLAGS:--Wall -Werror -Wextra -pedantic -std=gnu89}
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+gcc $CFLAGS *.c -o "$dir/hsh" || exit 1
+for t in tests/*_test.c; do
+	gcc $CFLAGS "$t" -o "$dir/test" && "$dir/test" || status=1
+done
+for t in tests/*.sh; do
+	[ "$t" = tests/run.sh ] && continue
+	sh "$t" "$dir/hsh" || status=1
+done
+exit $status
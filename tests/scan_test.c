@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <time.h>
+#include "../scan.c"
+
+/*
+ * Differential test of the vector scanners against the scalar one: every
+ * special byte is put at every length from 0 to SCAN_MAX_LEN after every
+ * alignment within a 64-byte line, so delimiters land on and around every
+ * 16- and 32-byte chunk boundary.  Random mixed text is checked too.
+ *
+ * With -b, times a scan over one long word instead.
+ *
+ * Usage: scan_test [-b]
+ */
+
+#define SCAN_MAX_LEN 130
+#define BENCH_LEN (1 << 20)
+#define BENCH_ROUNDS 200
+
+struct scanner {
+	const char *name;
+	char *(*scan)(const char *p);
+};
+
+static const char specials[] = " \t\n\v\f\r<>|&;\"\\$";
+
+/**
+ * scanners - list the implementations this CPU can run
+ * @list: receives them, scalar first
+ * Return: how many there are
+ */
+
+static int scanners(struct scanner *list)
+{
+	int n = 0;
+
+	scan_select("");
+	list[n].name = "scalar";
+	list[n++].scan = scan_scalar;
+#ifdef SCAN_X86
+	if (__builtin_cpu_supports("sse2"))
+	{
+		list[n].name = "sse2";
+		list[n++].scan = scan_sse2;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		list[n].name = "avx2";
+		list[n++].scan = scan_avx2;
+	}
+#endif
+	return (n);
+}
+
+/**
+ * check - compare every scanner with the scalar one on one string
+ * @list: scanners
+ * @n: number of scanners
+ * @p: string
+ * @what: description for the failure message
+ * Return: number of mismatches
+ */
+
+static int check(struct scanner *list, int n, const char *p, const char *what)
+{
+	char *want = scan_scalar(p), *got;
+	int i, bad = 0;
+
+	for (i = 1; i < n; i++)
+	{
+		got = list[i].scan(p);
+		if (got != want)
+		{
+			printf("scan_test: %s: %s stops at %ld, scalar at %ld\n",
+			       list[i].name, what, (long)(got - p), (long)(want - p));
+			bad++;
+		}
+	}
+	return (bad);
+}
+
+/**
+ * bench - time each scanner over a long word
+ * @list: scanners
+ * @n: number of scanners
+ * @buf: buffer of at least BENCH_LEN + 64 bytes
+ */
+
+static void bench(struct scanner *list, int n, char *buf)
+{
+	struct timespec t0, t1;
+	double ns;
+	int i, r;
+
+	memset(buf, 'a', BENCH_LEN);
+	buf[BENCH_LEN] = '\0';
+	for (i = 0; i < n; i++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (r = 0; r < BENCH_ROUNDS; r++)
+		{
+			if (list[i].scan(buf) != buf + BENCH_LEN)
+				printf("scan_test: %s: wrong result\n", list[i].name);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+		printf("%-8s %7.3f ns/byte  %7.2f GB/s\n", list[i].name,
+		       ns / ((double)BENCH_LEN * BENCH_ROUNDS),
+		       (double)BENCH_LEN * BENCH_ROUNDS / ns);
+	}
+}
+
+/**
+ * main - run the differential test, or the benchmark with -b
+ * @argc: argument count
+ * @argv: arguments
+ * Return: 0 if every scanner agrees with the scalar one, 1 otherwise
+ */
+
+int main(int argc, char **argv)
+{
+	static char raw[BENCH_LEN + 128];
+	char *buf = (char *)(((size_t)raw + 63) & ~(size_t)63), *p, what[64];
+	struct scanner list[3];
+	int n = scanners(list), bad = 0, len, r;
+	size_t align, s;
+
+	if (argc > 1 && strcmp(argv[1], "-b") == 0)
+	{
+		bench(list, n, buf);
+		return (0);
+	}
+
+	for (s = 0; s < sizeof(specials); s++)
+	{
+		for (align = 0; align < 64; align++)
+		{
+			for (len = 0; len <= SCAN_MAX_LEN; len++)
+			{
+				p = buf + align;
+				memset(buf, 'x', 256);
+				p[len] = specials[s];
+				p[len + 1] = '\0';
+				sprintf(what, "byte %d at offset %d, alignment %d",
+					(unsigned char)specials[s], len, (int)align);
+				bad += check(list, n, p, what);
+			}
+		}
+	}
+
+	srand(1);
+	for (r = 0; r < 100000; r++)
+	{
+		align = rand() % 64;
+		p = buf + align;
+		for (len = 0; len < SCAN_MAX_LEN; len++)
+			p[len] = rand() % 40 ? 'a' + rand() % 26 : specials[rand() % (sizeof(specials) - 1)];
+		p[SCAN_MAX_LEN] = '\0';
+		sprintf(what, "random string %d", r);
+		bad += check(list, n, p, what);
+	}
+
+	printf("scan_test: %s (%d scanners)\n", bad ? "FAILED" : "ok", n);
+	return (bad != 0);
+}
@@ -0,0 +1,167 @@
+#include "shell.h"
+
+/*
+ * The "time" reserved word.  A timed pipeline reports its wall-clock time
+ * and, per stage and in total, user and system time, peak RSS and
+ * voluntary/involuntary context switches.  Processes get their figures
+ * from wait4(); stages that ran inside the shell are charged the shell's
+ * own usage while they ran.  "set -o time-format=json" prints the same
+ * figures as one JSON object per pipeline.
+ */
+
+/**
+ * tv_us - convert a timeval to microseconds
+ * @tv: time
+ * Return: microseconds
+ */
+
+static long tv_us(const struct timeval *tv)
+{
+	return (tv->tv_sec * 1000000L + tv->tv_usec);
+}
+
+/**
+ * us_tv - convert microseconds to a timeval
+ * @us: microseconds
+ * @tv: receives the time
+ */
+
+static void us_tv(long us, struct timeval *tv)
+{
+	tv->tv_sec = us / 1000000L;
+	tv->tv_usec = us % 1000000L;
+}
+
+/**
+ * time_self_begin - sample the shell's usage before an in-shell stage
+ * @before: receives the sample
+ */
+
+void time_self_begin(struct rusage *before)
+{
+	getrusage(RUSAGE_SELF, before);
+}
+
+/**
+ * time_self_end - charge an in-shell stage with what the shell used
+ * @c: the stage
+ * @before: sample taken by time_self_begin()
+ */
+
+void time_self_end(struct child *c, const struct rusage *before)
+{
+	struct rusage now;
+
+	getrusage(RUSAGE_SELF, &now);
+	us_tv(tv_us(&now.ru_utime) - tv_us(&before->ru_utime), &c->rusage.ru_utime);
+	us_tv(tv_us(&now.ru_stime) - tv_us(&before->ru_stime), &c->rusage.ru_stime);
+	c->rusage.ru_maxrss = now.ru_maxrss;
+	c->rusage.ru_nvcsw = now.ru_nvcsw - before->ru_nvcsw;
+	c->rusage.ru_nivcsw = now.ru_nivcsw - before->ru_nivcsw;
+}
+
+/**
+ * time_line - format one row of the text report
+ * @buf: destination
+ * @size: size of @buf
+ * @label: row label
+ * @real: wall-clock microseconds
+ * @ru: usage
+ * Return: number of bytes written
+ */
+
+static int time_line(char *buf, size_t size, const char *label, long real,
+		     const struct rusage *ru)
+{
+	return (snprintf(buf, size, "%-6s %9.3fs %9.3fs %9.3fs %9ldK %7ld %7ld",
+			 label, real / 1e6, tv_us(&ru->ru_utime) / 1e6,
+			 tv_us(&ru->ru_stime) / 1e6, ru->ru_maxrss,
+			 ru->ru_nvcsw, ru->ru_nivcsw));
+}
+
+/**
+ * time_json - format usage as the members of a JSON object
+ * @buf: destination
+ * @size: size of @buf
+ * @real: wall-clock microseconds
+ * @ru: usage
+ * Return: number of bytes written
+ */
+
+static int time_json(char *buf, size_t size, long real, const struct rusage *ru)
+{
+	return (snprintf(buf, size,
+			 "\"real\":%.6f,\"user\":%.6f,\"sys\":%.6f,\"maxrss_kb\":%ld,"
+			 "\"vcsw\":%ld,\"ivcsw\":%ld",
+			 real / 1e6, tv_us(&ru->ru_utime) / 1e6,
+			 tv_us(&ru->ru_stime) / 1e6, ru->ru_maxrss,
+			 ru->ru_nvcsw, ru->ru_nivcsw));
+}
+
+/**
+ * time_report - print the report for a finished timed pipeline
+ * @pipeline: the pipeline
+ * @children: its stages, all done
+ * @real: wall-clock microseconds for the whole pipeline
+ */
+
+void time_report(Pipeline *pipeline, struct child *children, long real)
+{
+	struct rusage total;
+	char buf[512], label[16];
+	int i, n, json = shell_options[OPT_TIME_FORMAT].value == TIME_JSON;
+	long user = 0, sys = 0;
+
+	_memset((char *)&total, 0, sizeof(total));
+	for (i = 0; i < pipeline->command_count; i++)
+	{
+		user += tv_us(&children[i].rusage.ru_utime);
+		sys += tv_us(&children[i].rusage.ru_stime);
+		if (children[i].rusage.ru_maxrss > total.ru_maxrss)
+			total.ru_maxrss = children[i].rusage.ru_maxrss;
+		total.ru_nvcsw += children[i].rusage.ru_nvcsw;
+		total.ru_nivcsw += children[i].rusage.ru_nivcsw;
+	}
+	us_tv(user, &total.ru_utime);
+	us_tv(sys, &total.ru_stime);
+
+	if (json)
+	{
+		n = snprintf(buf, sizeof(buf), "{");
+		n += time_json(buf + n, sizeof(buf) - n, real, &total);
+		n += snprintf(buf + n, sizeof(buf) - n, ",\"status\":%d,\"stages\":[",
+			      children_status(children, pipeline->command_count));
+		_write_buf(STDERR_FILENO, buf, n);
+		for (i = 0; i < pipeline->command_count; i++)
+		{
+			n = snprintf(buf, sizeof(buf), "%s{\"cmd\":", i ? "," : "");
+			n += json_string(buf + n, sizeof(buf) - n - 256,
+					 pipeline->commands[i].name);
+			n += snprintf(buf + n, sizeof(buf) - n, ",\"pid\":%d,\"status\":%d,",
+				      (int)children[i].pid, children[i].status);
+			n += time_json(buf + n, sizeof(buf) - n,
+				       children[i].ended - children[i].started,
+				       &children[i].rusage);
+			n += snprintf(buf + n, sizeof(buf) - n, "}");
+			_write_buf(STDERR_FILENO, buf, n);
+		}
+		_puts_fd(STDERR_FILENO, "]}\n");
+		return;
+	}
+
+	_puts_fd(STDERR_FILENO,
+		 "stage        real       user        sys     maxrss    vcsw   ivcsw  command\n");
+	for (i = 0; i < pipeline->command_count; i++)
+	{
+		snprintf(label, sizeof(label), "%d", i);
+		time_line(buf, sizeof(buf), label, children[i].ended - children[i].started,
+			  &children[i].rusage);
+		_puts_fd(STDERR_FILENO, buf);
+		_puts_fd(STDERR_FILENO, "  ");
+		_puts_fd(STDERR_FILENO, pipeline->commands[i].name);
+		_puts_fd(STDERR_FILENO, "\n");
+	}
+	time_line(buf, sizeof(buf), "total", real, &total);
+	_puts_fd(STDERR_FILENO, buf);
+	_puts_fd(STDERR_FILENO, "\n");
+}
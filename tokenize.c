@@ -17,8 +17,18 @@ const char *TT_to_str(TokenType tt)
     return "EQUAL";
   case TOK_GREATERTHAN:
     return "GREATERTHAN";
+  case TOK_APPEND:
+    return "APPEND";
   case TOK_PIPE:
     return "PIPE";
+  case TOK_AMP:
+    return "AMP";
+  case TOK_SEMI:
+    return "SEMI";
+  case TOK_AND_IF:
+    return "AND_IF";
+  case TOK_OR_IF:
+    return "OR_IF";
   case TOK_END:
     return "(end)";
   }
@@ -26,69 +36,229 @@ const char *TT_to_str(TokenType tt)
   __builtin_unreachable();
 }
 
-CList TOK_tokenize_input(const char *input, char *errmsg __attribute__((unused)), size_t errmsg_sz __attribute__((unused)))
+/*
+ * Operator tokens carry a static spelling; word tokens are views into the
+ * input line.  Returns TOK_WORD if @p does not start an operator.
+ */
+static TokenType op_type(const char *p, Token *token)
 {
-  CList tokens = CL_new();
+  token->flags = 0;
+  token->length = 1;
+  switch (*p)
+  {
+  case '<':
+    token->value = "<";
+    return token->type = TOK_LESSTHAN;
+  case '>':
+    if (p[1] == '>')
+    {
+      token->value = ">>";
+      token->length = 2;
+      return token->type = TOK_APPEND;
+    }
+    token->value = ">";
+    return token->type = TOK_GREATERTHAN;
+  case '|':
+    if (p[1] == '|')
+    {
+      token->value = "||";
+      token->length = 2;
+      return token->type = TOK_OR_IF;
+    }
+    token->value = "|";
+    return token->type = TOK_PIPE;
+  case '&':
+    if (p[1] == '&')
+    {
+      token->value = "&&";
+      token->length = 2;
+      return token->type = TOK_AND_IF;
+    }
+    token->value = "&";
+    return token->type = TOK_AMP;
+  case ';':
+    token->value = ";";
+    return token->type = TOK_SEMI;
+  }
+  return token->type = TOK_WORD;
+}
 
-  const char *curr = input;
-  while (*curr != '\0')
+/*
+ * Returns the byte after the ')' that matches the '(' at @p, or the end of
+ * the line if it is never closed.  Parentheses inside double quotes or
+ * after a backslash do not count.
+ */
+static char *paren_end(char *p)
+{
+  int depth = 0;
+
+  for (; *p != '\0'; p++)
   {
-    Token token;
-    char buffer[1024];
-    int buffer_index = 0;
-    if (_isspace((unsigned char)*curr))
+    if (*p == '\\' && p[1] != '\0')
     {
-      curr++;
-      continue;
+      p++;
+    }
+    else if (*p == '\"')
+    {
+      for (p++; *p != '\0' && *p != '\"'; p++)
+      {
+        if (*p == '\\' && p[1] != '\0')
+        {
+          p++;
+        }
+      }
+      if (*p == '\0')
+      {
+        return p;
+      }
+    }
+    else if (*p == '(')
+    {
+      depth++;
+    }
+    else if (*p == ')' && --depth == 0)
+    {
+      return p + 1;
     }
+  }
+  return p;
+}
 
-    _memset(buffer, 0, sizeof(buffer));
+/*
+ * Tokenizes in place: word values point into @input, which is modified.
+ * Backslashes and the surrounding quotes are removed by shifting the rest
+ * of the word left, which only happens for words that contain them; every
+ * word is then NUL-terminated in the byte that ended it.  There is no
+ * length limit and no per-token allocation.
+ *
+ * Parameters are expanded at execution time, so a word with a '$' is
+ * flagged TOKF_EXPAND, and "\$" and "\\" keep their backslash for the
+ * expander to remove; that way a cached word still tells a literal '$'
+ * from a parameter.
+ *
+ * Command substitutions and arithmetic are copied through untouched up to
+ * their closing parenthesis, so that "$(ls | wc -l)", "$(( a < b ))" and
+ * a "(( i++ ))" command stay one word whatever spaces and operator
+ * characters they hold; the inner text is tokenized when it runs.
+ */
+CList TOK_tokenize_input(Arena *arena, char *input, char *errmsg __attribute__((unused)), size_t errmsg_sz __attribute__((unused)))
+{
+  CList tokens = CL_new(arena);
+  char *curr = input;
 
-    if (*curr == '<')
+  while (1)
+  {
+    Token token, op;
+    char *dst;
+    bool in_quotes = false;
+
+    while (_isspace((unsigned char)*curr))
     {
-      token.type = TOK_LESSTHAN;
       curr++;
     }
-    else if (*curr == '>')
+    if (*curr == '\0')
     {
-      token.type = TOK_GREATERTHAN;
-      curr++;
+      break;
     }
-    else if (*curr == '|')
+
+    if (op_type(curr, &op) != TOK_WORD)
     {
-      token.type = TOK_PIPE;
+      CL_append(tokens, op);
+      curr += op.length;
+      continue;
+    }
+
+    token.flags = 0;
+    if (*curr == '\"')
+    {
+      in_quotes = true;
+      token.flags |= TOKF_QUOTED;
       curr++;
     }
-    else
+    token.value = dst = curr;
+    if (!in_quotes && curr[0] == '(' && curr[1] == '(')
     {
+      dst = curr = paren_end(curr);
+    }
 
-      bool in_quotes = false;
-      if (*curr == '\"')
+    while (1)
+    {
+      /* ordinary bytes up to the next one that needs a decision */
+      char *stop = tok_scan(curr);
+
+      if (dst != curr)
       {
-        in_quotes = true;
-        curr++;
+        memmove(dst, curr, stop - curr);
       }
+      dst += stop - curr;
+      curr = stop;
 
-      while (*curr != '\0' && (in_quotes || (!_isspace((unsigned char)*curr) && *curr != '<' && *curr != '>' && *curr != '|')))
+      if (*curr == '\0')
       {
-        if (in_quotes && *curr == '\"')
+        break;
+      }
+      if (in_quotes)
+      {
+        if (*curr == '\"')
         {
           curr++;
           break;
         }
+      }
+      else if (_isspace((unsigned char)*curr) || op_type(curr, &op) != TOK_WORD)
+      {
+        break;
+      }
 
-        if (*curr == '\\' && *(curr + 1) != '\0')
-        {
-          curr++;
-        }
+      if (*curr == '$' && curr[1] == '(')
+      {
+        char *end = paren_end(curr + 1);
 
-        buffer[buffer_index++] = *curr;
+        token.flags |= TOKF_EXPAND;
+        memmove(dst, curr, end - curr);
+        dst += end - curr;
+        curr = end;
+        continue;
+      }
+      if (*curr == '$')
+      {
+        token.flags |= TOKF_EXPAND;
+      }
+      else if (*curr == '\\' && (curr[1] == '$' || curr[1] == '\\'))
+      {
+        token.flags |= TOKF_ESCAPED | TOKF_EXPAND;
+        *dst++ = *curr++;
+      }
+      else if (*curr == '\\' && *(curr + 1) != '\0')
+      {
+        token.flags |= TOKF_ESCAPED;
         curr++;
       }
 
-      token.type = in_quotes ? TOK_QUOTED_WORD : TOK_WORD;
+      *dst++ = *curr++;
     }
-    token.value = _strdup(buffer);
+
+    token.type = in_quotes ? TOK_QUOTED_WORD : TOK_WORD;
+    token.length = dst - token.value;
+
+    if (dst == curr && *curr != '\0')
+    {
+      /* the terminator lands on the delimiter: consume it first */
+      if (op_type(curr, &op) == TOK_WORD)
+      {
+        op.length = 1;
+      }
+      *curr = '\0';
+      curr += op.length;
+      CL_append(tokens, token);
+      if (op.type != TOK_WORD)
+      {
+        CL_append(tokens, op);
+      }
+      continue;
+    }
+
+    *dst = '\0';
     CL_append(tokens, token);
   }
 
@@ -117,23 +287,3 @@ void TOK_consume(CList tokens)
 
   CL_pop(tokens);
 }
-
-void TOK_free_tokens(CList tokens)
-{
-  if (tokens == NULL)
-  {
-    return;
-  }
-
-  while (CL_length(tokens) > 0)
-  {
-    Token token = CL_pop(tokens);
-    if (token.value != NULL)
-    {
-      free(token.value);
-      token.value = NULL;
-    }
-  }
-
-  CL_free(tokens);
-}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "shell.h"
+#include <time.h>
+
+/*
+ * Phase timing, enabled with "set -o trace-timing" or HSH_TRACE_TIMING=1.
+ * Every line, tokenize, parse, command lookup, spawn and wait becomes a
+ * complete ("ph":"X") event with microsecond timestamps from the
+ * monotonic clock, and every pipeline stage becomes one more event that
+ * spans its process from spawn to reap, in a lane (tid) of its own.
+ *
+ * Events go to the descriptor in "set -o trace-fd" (stderr by default),
+ * either as a Chrome trace-event array, which chrome://tracing and
+ * Perfetto load even without the closing ']', or as one JSON object per
+ * line.  When tracing is off, trace_begin() returns 0 and every other
+ * call returns at once.
+ */
+
+static int trace_array_fd = -1;
+
+/**
+ * clock_us - read the monotonic clock
+ * Return: microseconds since an arbitrary point, never 0
+ */
+
+long clock_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000L + ts.tv_nsec / 1000 + 1);
+}
+
+/**
+ * trace_begin - start timing a phase
+ * Return: the start time, or 0 when tracing is off
+ */
+
+long trace_begin(void)
+{
+	return (shell_options[OPT_TRACE_TIMING].value ? clock_us() : 0);
+}
+
+/**
+ * json_string - append a string to a buffer as a JSON string literal
+ * @dst: buffer
+ * @size: size of @dst
+ * @s: string
+ * Return: number of bytes written, without the terminator
+ */
+
+size_t json_string(char *dst, size_t size, const char *s)
+{
+	size_t n = 0;
+
+	if (size < 3)
+		return (0);
+	dst[n++] = '"';
+	for (; *s != '\0' && n + 8 < size; s++)
+	{
+		if (*s == '"' || *s == '\\')
+		{
+			dst[n++] = '\\';
+			dst[n++] = *s;
+		}
+		else if ((unsigned char)*s < 0x20)
+		{
+			n += snprintf(dst + n, size - n, "\\u%04x", (unsigned char)*s);
+		}
+		else
+		{
+			dst[n++] = *s;
+		}
+	}
+	dst[n++] = '"';
+	dst[n] = '\0';
+	return (n);
+}
+
+/**
+ * trace_emit - write one complete event
+ * @name: event name
+ * @cmd: command the event belongs to, or NULL
+ * @ts: start time
+ * @end: end time
+ * @tid: lane: the shell's pid for shell phases, the child's for stages
+ * @status: exit status to attach, or -1 for none
+ */
+
+static void trace_emit(const char *name, const char *cmd, long ts, long end,
+		       pid_t tid, int status)
+{
+	char buf[512];
+	size_t n;
+	int fd = shell_options[OPT_TRACE_FD].value;
+	int chrome = shell_options[OPT_TRACE_FORMAT].value == TRACE_CHROME;
+
+	if (chrome && trace_array_fd != fd)
+	{
+		_write_buf(fd, "[\n", 2);
+		trace_array_fd = fd;
+	}
+
+	n = snprintf(buf, sizeof(buf),
+		     "{\"name\":\"%s\",\"cat\":\"hsh\",\"ph\":\"X\",\"ts\":%ld,"
+		     "\"dur\":%ld,\"pid\":%d,\"tid\":%d,\"args\":{",
+		     name, ts, end - ts, (int)getpid(), (int)tid);
+	if (cmd != NULL)
+	{
+		n += snprintf(buf + n, sizeof(buf) - n, "\"cmd\":");
+		n += json_string(buf + n, sizeof(buf) - n - 32, cmd);
+	}
+	if (status >= 0)
+		n += snprintf(buf + n, sizeof(buf) - n, "%s\"status\":%d",
+			      cmd != NULL ? "," : "", status);
+	n += snprintf(buf + n, sizeof(buf) - n, chrome ? "}},\n" : "}}\n");
+	_write_buf(fd, buf, n);
+}
+
+/**
+ * trace_end - finish timing a phase of the shell itself
+ * @name: phase name
+ * @cmd: command the phase belongs to, or NULL
+ * @t0: value returned by trace_begin()
+ */
+
+void trace_end(const char *name, const char *cmd, long t0)
+{
+	if (t0 == 0)
+		return;
+	trace_emit(name, cmd, t0, clock_us(), getpid(), -1);
+}
+
+/**
+ * trace_child - report a pipeline stage from start to reap
+ * @c: stage, with started and ended set
+ * @cmd: command name
+ */
+
+void trace_child(struct child *c, const char *cmd)
+{
+	if (c->started == 0)
+		return;
+	trace_emit("stage", cmd, c->started, c->ended ? c->ended : c->started,
+		   c->pid > 0 ? c->pid : getpid(), c->status);
+}
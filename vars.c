@@ -0,0 +1,482 @@
+#include "shell.h"
+
+extern char **environ;
+
+/*
+ * Shell variables.  Every variable is one "name=value" string in a
+ * chained hash table, so an exported variable's string goes into the
+ * environment of a child as it is.  The envp array handed to exec is
+ * built on first use and rebuilt only after an exported variable has been
+ * set, exported or unset; between such changes every spawn reuses it.
+ *
+ * var_generation counts every change, exported or not, so callers that
+ * derive something from a variable can tell when it may be out of date.
+ */
+
+struct var {
+	struct var *next;
+	unsigned long hash;
+	size_t name_len;
+	int flags;
+	char *str;
+};
+
+static struct var **var_table;
+static size_t var_table_size;
+static size_t var_count;
+
+static char **envp_cache;
+static size_t envp_cap;
+static unsigned long env_generation = 1, envp_generation;
+
+unsigned long var_generation;
+
+/**
+ * var_hash - FNV-1a hash of a name
+ * @name: name
+ * @len: length of @name
+ * Return: hash value
+ */
+
+static unsigned long var_hash(const char *name, size_t len)
+{
+	unsigned long h = 2166136261UL;
+
+	while (len-- > 0)
+	{
+		h ^= (unsigned char)*name++;
+		h *= 16777619UL;
+	}
+	return (h);
+}
+
+/**
+ * var_slot - find the link pointing at a variable, or the end of its chain
+ * @name: name
+ * @len: length of @name
+ * @hash: hash of @name
+ * Return: the link, or NULL while the table is empty
+ */
+
+static struct var **var_slot(const char *name, size_t len, unsigned long hash)
+{
+	struct var **pp;
+
+	if (var_table_size == 0)
+		return (NULL);
+	for (pp = &var_table[hash & (var_table_size - 1)]; *pp != NULL; pp = &(*pp)->next)
+	{
+		if ((*pp)->hash == hash && (*pp)->name_len == len &&
+		    memcmp((*pp)->str, name, len) == 0)
+			break;
+	}
+	return (pp);
+}
+
+/**
+ * var_grow - double the table and relink every variable
+ * Return: 0 on success, -1 on allocation failure
+ */
+
+static int var_grow(void)
+{
+	size_t size = var_table_size ? var_table_size * 2 : HASH_MIN_SIZE, i;
+	struct var **table = calloc(size, sizeof(*table)), *v, *next;
+
+	if (table == NULL)
+		return (-1);
+	for (i = 0; i < var_table_size; i++)
+	{
+		for (v = var_table[i]; v != NULL; v = next)
+		{
+			next = v->next;
+			v->next = table[v->hash & (size - 1)];
+			table[v->hash & (size - 1)] = v;
+		}
+	}
+	free(var_table);
+	var_table = table;
+	var_table_size = size;
+	return (0);
+}
+
+/**
+ * var_store - set a variable from a name of known length
+ * @name: name, not necessarily terminated
+ * @len: length of @name
+ * @value: value, or NULL to keep the current one (or "" for a new one)
+ * @flags: VAR_* flags to add
+ * Return: 0 on success, -1 on allocation failure
+ */
+
+static int var_store(const char *name, size_t len, const char *value, int flags)
+{
+	unsigned long hash = var_hash(name, len);
+	struct var **pp = var_slot(name, len, hash), *v = pp ? *pp : NULL;
+	size_t vlen;
+	char *str;
+
+	if (v != NULL && value == NULL)
+	{
+		if ((v->flags | flags) != v->flags)
+			env_generation++;
+		v->flags |= flags;
+		var_generation++;
+		return (0);
+	}
+	if (value == NULL)
+		value = "";
+	vlen = strlen(value);
+	str = malloc(len + vlen + 2);
+	if (str == NULL)
+		return (-1);
+	memcpy(str, name, len);
+	str[len] = '=';
+	memcpy(str + len + 1, value, vlen + 1);
+
+	if (v == NULL)
+	{
+		if ((var_count + 1 > var_table_size && var_grow() != 0) ||
+		    (v = malloc(sizeof(*v))) == NULL)
+		{
+			free(str);
+			return (-1);
+		}
+		v->hash = hash;
+		v->name_len = len;
+		v->flags = 0;
+		v->str = NULL;
+		v->next = var_table[hash & (var_table_size - 1)];
+		var_table[hash & (var_table_size - 1)] = v;
+		var_count++;
+	}
+	free(v->str);
+	v->str = str;
+	v->flags |= flags;
+	if (v->flags & VAR_EXPORT)
+		env_generation++;
+	var_generation++;
+	options_var_set(name, len, value);
+	return (0);
+}
+
+/**
+ * vars_init - take the initial variables from the environment, all
+ * exported
+ */
+
+void vars_init(void)
+{
+	char **env, *eq;
+
+	for (env = environ; *env != NULL; env++)
+	{
+		eq = strchr(*env, '=');
+		if (eq != NULL)
+			var_store(*env, eq - *env, eq + 1, VAR_EXPORT);
+	}
+}
+
+/**
+ * var_get - look a variable up
+ * @name: name
+ * Return: its value, valid until it next changes, or NULL if it is unset
+ */
+
+char *var_get(const char *name)
+{
+	return (var_getn(name, strlen(name)));
+}
+
+/**
+ * var_getn - look a variable up by a name of known length
+ * @name: name, not necessarily terminated
+ * @len: length of @name
+ * Return: its value, valid until it next changes, or NULL if it is unset
+ */
+
+char *var_getn(const char *name, size_t len)
+{
+	struct var **pp = var_slot(name, len, var_hash(name, len));
+
+	if (pp == NULL || *pp == NULL)
+		return (NULL);
+	return ((*pp)->str + len + 1);
+}
+
+/**
+ * var_set - set a variable
+ * @name: name
+ * @value: value, or NULL to only add @flags
+ * @flags: VAR_* flags to add
+ * Return: 0 on success, -1 on allocation failure
+ */
+
+int var_set(const char *name, const char *value, int flags)
+{
+	return (var_store(name, strlen(name), value, flags));
+}
+
+/**
+ * var_setn - set a variable by a name of known length
+ * @name: name, not necessarily terminated
+ * @len: length of @name
+ * @value: value
+ * @flags: VAR_* flags to add
+ * Return: 0 on success, -1 on allocation failure
+ */
+
+int var_setn(const char *name, size_t len, const char *value, int flags)
+{
+	return (var_store(name, len, value, flags));
+}
+
+/**
+ * var_unset - remove a variable
+ * @name: name
+ */
+
+void var_unset(const char *name)
+{
+	size_t len = strlen(name);
+	struct var **pp = var_slot(name, len, var_hash(name, len)), *v;
+
+	if (pp == NULL || *pp == NULL)
+		return;
+	v = *pp;
+	*pp = v->next;
+	if (v->flags & VAR_EXPORT)
+		env_generation++;
+	var_generation++;
+	var_count--;
+	free(v->str);
+	free(v);
+}
+
+/**
+ * var_environ - the environment for a child
+ * Return: NULL-terminated array of the exported "name=value" strings,
+ * valid until an exported variable changes
+ */
+
+char **var_environ(void)
+{
+	struct var *v;
+	char **tmp;
+	size_t i, n = 0;
+
+	if (envp_generation == env_generation)
+		return (envp_cache);
+	if (var_count + 1 > envp_cap)
+	{
+		tmp = realloc(envp_cache, (var_count + 1) * sizeof(*tmp));
+		if (tmp == NULL)
+			return (environ);
+		envp_cache = tmp;
+		envp_cap = var_count + 1;
+	}
+	for (i = 0; i < var_table_size; i++)
+	{
+		for (v = var_table[i]; v != NULL; v = v->next)
+		{
+			if (v->flags & VAR_EXPORT)
+				envp_cache[n++] = v->str;
+		}
+	}
+	envp_cache[n] = NULL;
+	envp_generation = env_generation;
+	return (envp_cache);
+}
+
+/**
+ * var_name_len - measure the name at the start of a word
+ * @s: word
+ * Return: length of the longest valid variable name @s starts with
+ */
+
+size_t var_name_len(const char *s)
+{
+	size_t n = 0;
+
+	if (!(s[0] == '_' || (s[0] >= 'a' && s[0] <= 'z') || (s[0] >= 'A' && s[0] <= 'Z')))
+		return (0);
+	for (n = 1; s[n] == '_' || (s[n] >= 'a' && s[n] <= 'z') ||
+		     (s[n] >= 'A' && s[n] <= 'Z') || (s[n] >= '0' && s[n] <= '9'); n++)
+		;
+	return (n);
+}
+
+/**
+ * var_is_assignment - tell whether a word is "name=value"
+ * @word: word
+ * Return: 1 if it is, 0 otherwise
+ */
+
+int var_is_assignment(const char *word)
+{
+	size_t n = var_name_len(word);
+
+	return (n > 0 && word[n] == '=');
+}
+
+/**
+ * var_bad_name - report an invalid name
+ * @cmd: builtin reporting it
+ * @name: the name
+ * Return: 1
+ */
+
+static int var_bad_name(char *cmd, char *name)
+{
+	_puts_fd(STDERR_FILENO, cmd);
+	_puts_fd(STDERR_FILENO, ": '");
+	_puts_fd(STDERR_FILENO, name);
+	_puts_fd(STDERR_FILENO, "': not a valid identifier\n");
+	return (1);
+}
+
+/**
+ * var_assign - apply one "name=value" word
+ * @word: the word
+ * @flags: VAR_* flags to add
+ * Return: 0 on success, -1 on allocation failure
+ */
+
+static int var_assign(char *word, int flags)
+{
+	size_t n = var_name_len(word);
+
+	if (var_store(word, n, word + n + 1, flags) != 0)
+	{
+		_perror("malloc");
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * assign_builtin - run a command made of "name=value" words
+ * @args: argument vector
+ *
+ * Assignments in front of a command ("name=value cmd") would only apply
+ * to that command; they are not supported and are reported as an error.
+ * Return: 0 on success, 1 on failure, 2 if a word is not an assignment
+ */
+
+int assign_builtin(char **args)
+{
+	int i;
+
+	for (i = 0; args[i] != NULL; i++)
+	{
+		if (!var_is_assignment(args[i]))
+		{
+			_puts_fd(STDERR_FILENO, args[i]);
+			_puts_fd(STDERR_FILENO, ": assignments before a command are not supported\n");
+			return (2);
+		}
+	}
+	for (i = 0; args[i] != NULL; i++)
+	{
+		if (var_assign(args[i], 0) != 0)
+			return (1);
+	}
+	return (0);
+}
+
+/**
+ * var_str_cmp - qsort comparator for "name=value" strings
+ * @a: first string pointer
+ * @b: second string pointer
+ * Return: strcmp-style ordering
+ */
+
+static int var_str_cmp(const void *a, const void *b)
+{
+	return (strcmp(*(char * const *)a, *(char * const *)b));
+}
+
+/**
+ * export_print - list the exported variables as "export" commands
+ * Return: 0 on success, 1 on allocation failure
+ */
+
+static int export_print(void)
+{
+	char **env = var_environ(), **sorted, *eq;
+	size_t n, i;
+
+	for (n = 0; env[n] != NULL; n++)
+		;
+	sorted = malloc((n + 1) * sizeof(*sorted));
+	if (sorted == NULL)
+	{
+		_perror("malloc");
+		return (1);
+	}
+	memcpy(sorted, env, (n + 1) * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), var_str_cmp);
+	for (i = 0; i < n; i++)
+	{
+		eq = strchr(sorted[i], '=');
+		_puts("export ");
+		_write_buf(STDOUT_FILENO, sorted[i], eq - sorted[i]);
+		_puts("=\"");
+		_puts(eq + 1);
+		_puts("\"\n");
+	}
+	free(sorted);
+	return (0);
+}
+
+/**
+ * export_builtin - the "export" builtin
+ * @args: argument vector: names or "name=value" words
+ * Return: 0 on success, 1 if a name is invalid
+ */
+
+int export_builtin(char **args)
+{
+	int status = 0;
+
+	if (args[1] == NULL)
+		return (export_print());
+	for (args++; *args != NULL; args++)
+	{
+		if (var_is_assignment(*args))
+		{
+			if (var_assign(*args, VAR_EXPORT) != 0)
+				status = 1;
+		}
+		else if (var_name_len(*args) == strlen(*args))
+		{
+			if (var_set(*args, NULL, VAR_EXPORT) != 0)
+				status = 1;
+		}
+		else
+		{
+			status = var_bad_name("export", *args);
+		}
+	}
+	return (status);
+}
+
+/**
+ * unset_builtin - the "unset" builtin
+ * @args: argument vector: names
+ * Return: 0 on success, 1 if a name is invalid
+ */
+
+int unset_builtin(char **args)
+{
+	int status = 0;
+
+	for (args++; *args != NULL; args++)
+	{
+		if (var_name_len(*args) == 0 || var_name_len(*args) != strlen(*args))
+			status = var_bad_name("unset", *args);
+		else
+			var_unset(*args);
+	}
+	return (status);
+}